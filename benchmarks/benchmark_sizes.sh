@@ -17,5 +17,6 @@ for C in 0 1; do
   # GMW RAM usage can take it
   S=0
   D=25000 $cmd_gmw
-  # for D=100000 there's an overflow in CBitVector...
+  # for D=100000 there's an overflow in CBitVector, link it in chunks
+  # (test_sel -C) instead
 done
@@ -16,8 +16,10 @@
  \brief ABY share wrapper
 */
 
+#include <numeric>
 #include <fmt/format.h>
 #include "Share.h"
+#include "gate_file.h"
 #include "../math.h"
 #include "../util.h"
 
@@ -50,16 +52,31 @@ BoolShare apply_file_binary(const BoolShare& a, const BoolShare& b,
   copy_n(begin(a_wires), a_bits, back_inserter(in));
   copy_n(begin(b_wires), b_bits, back_inserter(in));
 
-  return BoolShare{a.bcirc, a.bcirc->PutGateFromFile(fn, in, a.get_nvals())};
+  // The circuit file is only parsed on first use
+  return BoolShare{a.bcirc,
+    get_cached_gate_file(fn)->put_gates(a.bcirc, in, a.get_nvals())};
+}
+
+/**
+ * Splitting sizes of ceil(nvals/new_nval) shares of nvals new_nval, the last
+ * one possibly smaller
+ */
+vector<uint32_t> split_sizes(uint32_t nvals, uint32_t new_nval) {
+  const size_t numshares{ceil_div<uint32_t>(nvals, new_nval)};
+  vector<uint32_t> new_nvals(numshares, new_nval);
+  if (nvals%new_nval) new_nvals.back() = nvals%new_nval;
+  return new_nvals;
 }
 
 vector<BoolShare> BoolShare::split(uint32_t new_nval) const {
-  const size_t bitlen{get_bitlen()}, nvals{get_nvals()},
-      numshares{ceil_div<uint32_t>(nvals, new_nval)};
+  return split(split_sizes(get_nvals(), new_nval));
+}
+
+vector<BoolShare> BoolShare::split(const vector<uint32_t>& new_nvals) const {
+  const size_t bitlen{get_bitlen()}, numshares{new_nvals.size()};
+  assert (accumulate(new_nvals.cbegin(), new_nvals.cend(), 0u) == get_nvals());
   vector<vector<uint32_t>> split_wires;
   split_wires.reserve(bitlen);
-  vector<uint32_t> new_nvals(numshares, new_nval);
-  if (nvals%new_nval) new_nvals.back() = nvals%new_nval;
 
   for (uint32_t id : sh.get()->get_wires()) {
     split_wires.emplace_back(bcirc->PutSplitterGate(id, new_nvals));
@@ -81,15 +98,16 @@ vector<BoolShare> BoolShare::split(uint32_t new_nval) const {
 }
 
 vector<ArithShare> ArithShare::split(uint32_t new_nval) const {
-  const size_t nvals{get_nvals()}, numshares{ceil_div<uint32_t>(nvals, new_nval)};
-  vector<uint32_t> new_nvals(numshares, new_nval);
-  if (nvals%new_nval) new_nvals.back() = nvals%new_nval;
+  return split(split_sizes(get_nvals(), new_nval));
+}
 
+vector<ArithShare> ArithShare::split(const vector<uint32_t>& new_nvals) const {
+  assert (accumulate(new_nvals.cbegin(), new_nvals.cend(), 0u) == get_nvals());
   auto split_wires = acirc->PutSplitterGate(sh.get()->get_wire_id(0), new_nvals);
-  assert (numshares == split_wires.size());
+  assert (new_nvals.size() == split_wires.size());
 
   vector<ArithShare> res;
-  res.reserve(numshares);
+  res.reserve(new_nvals.size());
   for(uint32_t w : split_wires)
     res.emplace_back(ArithShare(acirc,
           new arithshare(vector<uint32_t>(1,w), acirc)));
@@ -106,15 +124,28 @@ BoolShare BoolShare::zeropad(uint32_t bitlen) const {
   return BoolShare{bcirc, wires};
 }
 
+BoolShare BoolShare::truncate(uint32_t bitlen) const {
+  assert(bitlen <= get_bitlen());
+
+  const auto& wires = sh->get_wires();
+  return BoolShare{bcirc, vector<uint32_t>(wires.cbegin(), wires.cbegin() + bitlen)};
+}
+
+BoolShare BoolShare::bit(uint32_t i) const {
+  assert(i < get_bitlen());
+
+  return BoolShare{bcirc, vector<uint32_t>{sh->get_wires()[i]}};
+}
+
 /******************** OutShare ********************/
 
-vector<uint32_t> OutShare::get_clear_value_vec() {
-  uint32_t* arr;
+vector<uint64_t> OutShare::get_clear_value_vec() {
+  uint64_t* arr;
   uint32_t nvals, bitlen;
   sh->get_clear_value_vec(&arr, &bitlen, &nvals);
-  assert(bitlen == 32); // TODO <= 32
+  assert(bitlen <= 64);
 
-  vector<uint32_t> vec(arr, arr+nvals);
+  vector<uint64_t> vec(arr, arr+nvals);
 
   return vec;
 }
@@ -211,5 +242,16 @@ ShareT vcombine(const vector<ShareT>& shares) {
 template BoolShare vcombine(const vector<BoolShare>&);
 template ArithShare vcombine(const vector<ArithShare>&);
 
+BoolShare hcombine(const vector<BoolShare>& shares) {
+  auto bcirc = shares.at(0).get_circuit();
+  vector<uint32_t> wires;
+  for (const auto& share : shares) {
+    assert(share.get_nvals() == shares[0].get_nvals());
+    const auto& w = share.get()->get_wires();
+    wires.insert(wires.end(), w.cbegin(), w.cend());
+  }
+  return {bcirc, wires};
+}
+
 // TODO all, any, prod -> gadgets
 } // namespace sel
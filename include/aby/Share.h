@@ -122,7 +122,7 @@ class Share {
 
   explicit operator bool() const noexcept { return (bool)sh; };
 
-  Share repeat(uint32_t n) {
+  Share repeat(uint32_t n) const {
     return Share{circ, circ->PutRepeaterGate(n, sh.get())};
   }
 
@@ -267,6 +267,17 @@ class BoolShare: public Share {
    */
   BoolShare zeropad(uint32_t bitlen) const;
 
+  /**
+   * Returns this share with only the given number of least significant bits.
+   * Unlike set_bitlength(), this share is left untouched.
+   */
+  BoolShare truncate(uint32_t bitlen) const;
+
+  /**
+   * Returns the single-wired share of the i-th bit
+   */
+  BoolShare bit(uint32_t i) const;
+
   friend BoolShare hammingweight(const BoolShare& s) {
     return BoolShare{s.bcirc, s.bcirc->PutHammingWeightGate(s.get())};
   }
@@ -274,6 +285,7 @@ class BoolShare: public Share {
   /**
    * Run circuit specification from given file path and inputs.
    * Only the specified bits will be used.
+   * Parsed circuit files are cached in memory.
    */
   friend BoolShare apply_file_binary(const BoolShare& a, const BoolShare& b,
       uint32_t a_bits, uint32_t b_bits, const std::string& fn);
@@ -283,6 +295,12 @@ class BoolShare: public Share {
    */
   std::vector<BoolShare> split(uint32_t new_nval) const;
 
+  /**
+   * Spits a simd share into shares of the given nvals, which must sum up to
+   * this share's nvals
+   */
+  std::vector<BoolShare> split(const std::vector<uint32_t>& new_nvals) const;
+
 
   protected:
   BooleanCircuit* bcirc;
@@ -337,6 +355,12 @@ class ArithShare: public Share {
    */
   std::vector<ArithShare> split(uint32_t new_nval) const;
 
+  /**
+   * Spits a simd share into shares of the given nvals, which must sum up to
+   * this share's nvals
+   */
+  std::vector<ArithShare> split(const std::vector<uint32_t>& new_nvals) const;
+
   protected:
   ArithmeticCircuit* acirc;
 };
@@ -351,7 +375,10 @@ class OutShare: private Share {
     return sh->get_clear_value<T>();
   }
 
-  std::vector<uint32_t> get_clear_value_vec();
+  // Wide enough for all bitlens of arithmetic shares
+  std::vector<uint64_t> get_clear_value_vec();
+
+  using Share::get_nvals;
 };
 
 /******************** Factories ********************/
@@ -406,6 +433,12 @@ BoolShare b2y(BooleanCircuit* ycirc, const BoolShare& s);
 template <class ShareT>
 ShareT vcombine(const std::vector<ShareT>&);
 
+/**
+ * Horizontally combines the given shares of equal nvals to a new share having
+ * the wires of all shares, the first share's wires being least significant
+ */
+BoolShare hcombine(const std::vector<BoolShare>&);
+
 } // namespace sel
 
 #endif /* end of include guard: SEL_ABY_SHARE_H */
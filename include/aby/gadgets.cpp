@@ -19,6 +19,7 @@
 #include <memory>
 #include <type_traits>
 #include "gadgets.h"
+#include "ranged_share.hpp"
 #include "../util.h"
 
 #ifdef DEBUG_SEL_GADGETS
@@ -172,6 +173,56 @@ BoolShare split_accumulate(BoolShare simd_share, const BinaryOp<BoolShare>& op)
   return simd_share;
 }
 
+BoolShare segmented_accumulate(BoolShare simd_share, size_t segment_size,
+    const BinaryOp<BoolShare>& op) {
+  assert (segment_size > 0 && simd_share.get_nvals() % segment_size == 0);
+  const size_t nseg = simd_share.get_nvals() / segment_size;
+  const auto combine = [](const vector<BoolShare>& shares) {
+    return (shares.size() == 1) ? shares[0] : vcombine<BoolShare>(shares);
+  };
+
+  while (segment_size > 1) {
+    const uint32_t half = segment_size/2;
+    const bool odd = segment_size%2;
+#ifdef DEBUG_SEL_GADGETS
+    cout << "segmented accumulate: " << nseg << " segments of size "
+      << segment_size << "\n";
+#endif
+    // Split layout per segment: [half, half, (odd)]
+    vector<uint32_t> sizes;
+    sizes.reserve(3*nseg);
+    for (size_t i = 0; i != nseg; ++i) {
+      sizes.insert(sizes.end(), {half, half});
+      if (odd) sizes.push_back(1);
+    }
+    auto parts = simd_share.split(sizes);
+
+    const size_t stride = odd ? 3 : 2;
+    vector<BoolShare> lefts, rights;
+    lefts.reserve(nseg);
+    rights.reserve(nseg);
+    for (size_t i = 0; i != nseg; ++i) {
+      lefts.emplace_back(move(parts[stride*i]));
+      rights.emplace_back(move(parts[stride*i + 1]));
+    }
+    simd_share = op(combine(lefts), combine(rights));
+
+    if (odd) {
+      // Re-append odd element to each segment
+      auto folded = (nseg > 1) ? simd_share.split(half) : vector<BoolShare>{simd_share};
+      vector<BoolShare> merged;
+      merged.reserve(2*nseg);
+      for (size_t i = 0; i != nseg; ++i) {
+        merged.emplace_back(move(folded[i]));
+        merged.emplace_back(move(parts[3*i + 2]));
+      }
+      simd_share = vcombine<BoolShare>(merged);
+    }
+    segment_size = half + odd;
+  }
+  return simd_share;
+}
+
 void split_select_target(BoolShare& selector, BoolShare& target,
     const BinaryOp<BoolShare>& op_select) {
   assert (selector.get_nvals() == target.get_nvals());
@@ -229,31 +280,38 @@ void split_select_target(BoolShare& selector, BoolShare& target,
   }
 }
 
+/**
+ * The quotient's shares with the given widths. Unknown widths default to the
+ * shares' bitlens and the maximum width to the wider of them, which is what a
+ * plain multiplication of both would use.
+ */
+template <class ShareT>
+Quotient<Ranged<ShareT>> ranged(const Quotient<ShareT>& q,
+    const QuotientBitWidths& widths) {
+  const size_t max_bits = widths.max ? widths.max :
+    std::max(q.num.get_bitlen(), q.den.get_bitlen());
+  return {{q.num, widths.num ? widths.num : q.num.get_bitlen(), max_bits},
+    {q.den, widths.den ? widths.den : q.den.get_bitlen(), max_bits}};
+}
+
 template <class ShareT>
 QuotientSelector<ShareT> make_tie_selector(const T2BConverter<ShareT>& to_bool,
-    const BinaryOp<BoolShare>& op_select, const size_t den_bits = 0) {
-  return [&to_bool, op_select, den_bits] (auto a, auto b) {
-      BoolShare ax, bx, a_den, b_den;
-      if constexpr(is_same_v<ShareT, ArithShare>) {
-        ax = to_bool(a.num * b.den);
-        bx = to_bool(b.num * a.den);
-        a_den = to_bool(a.den);
-        b_den = to_bool(b.den);
-      } else {
-        ax = a.num * b.den;
-        bx = b.num * a.den;
-        a_den = a.den;
-        b_den = b.den;
-      }
+    const BinaryOp<BoolShare>& op_select, const QuotientBitWidths& widths) {
+  return [&to_bool, op_select, widths] (auto a, auto b) {
+      const auto ra = ranged(a, widths), rb = ranged(b, widths);
+      // Cross products only need the width of numerator and denominator
+      // together, denominators their own width.
+      const auto ax = converted(ra.num * rb.den, to_bool);
+      const auto bx = converted(rb.num * ra.den, to_bool);
+      const auto a_den = converted(ra.den, to_bool);
+      const auto b_den = converted(rb.den, to_bool);
 
       auto quotients_equal = ax == bx;
-      auto quotient_select = op_select(ax, bx);
+      const size_t x_bits = std::max(ax.bits(), bx.bits());
+      auto quotient_select = op_select(ax.padded(x_bits), bx.padded(x_bits));
 
-      if (den_bits) {
-        a_den.set_bitlength(den_bits);
-        b_den.set_bitlength(den_bits);
-      }
-      auto scale_select = op_select(a_den, b_den);
+      const size_t den_bits = std::max(a_den.bits(), b_den.bits());
+      auto scale_select = op_select(a_den.padded(den_bits), b_den.padded(den_bits));
 
       // If quotients are equal, select by scale.
       auto selection = quotient_select | (quotients_equal & scale_select);
@@ -263,8 +321,8 @@ QuotientSelector<ShareT> make_tie_selector(const T2BConverter<ShareT>& to_bool,
       const string i_str = '[' + to_string(i++) + "] ";
       print_share(a, i_str+"selector a");
       print_share(b, i_str+"selector b");
-      print_share(a_den, i_str+"a_den");
-      print_share(b_den, i_str+"b_den");
+      print_share(a_den.get(), i_str+"a_den");
+      print_share(b_den.get(), i_str+"b_den");
       print_share(quotients_equal, i_str+"quotients_equal");
       print_share(quotient_select, i_str+"quotient_select");
       print_share(scale_select, i_str+"scale_select");
@@ -277,9 +335,22 @@ QuotientSelector<ShareT> make_tie_selector(const T2BConverter<ShareT>& to_bool,
 
 template <class ShareT>
 QuotientSelector<ShareT> make_max_tie_selector(const T2BConverter<ShareT>& to_bool,
-    const size_t den_bits) {
+    const QuotientBitWidths& widths) {
   BinaryOp<BoolShare> op_select = [](auto a, auto b) { return a > b; };
-  return make_tie_selector(to_bool, op_select, den_bits);
+  return make_tie_selector(to_bool, op_select, widths);
+}
+
+template
+QuotientSelector<BoolShare> make_max_tie_selector(const T2BConverter<BoolShare>&,
+    const QuotientBitWidths&);
+template
+QuotientSelector<ArithShare> make_max_tie_selector(const T2BConverter<ArithShare>&,
+    const QuotientBitWidths&);
+
+template <class ShareT>
+QuotientSelector<ShareT> make_max_tie_selector(const T2BConverter<ShareT>& to_bool,
+    const size_t den_bits) {
+  return make_max_tie_selector(to_bool, QuotientBitWidths{0, den_bits, 0});
 }
 
 template
@@ -289,9 +360,22 @@ QuotientSelector<ArithShare> make_max_tie_selector(const T2BConverter<ArithShare
 
 template <class ShareT>
 QuotientSelector<ShareT> make_min_tie_selector(const T2BConverter<ShareT>& to_bool,
-    const size_t den_bits) {
+    const QuotientBitWidths& widths) {
   BinaryOp<BoolShare> op_select = [](auto a, auto b) { return a < b; };
-  return make_tie_selector(to_bool, op_select, den_bits);
+  return make_tie_selector(to_bool, op_select, widths);
+}
+
+template
+QuotientSelector<BoolShare> make_min_tie_selector(const T2BConverter<BoolShare>&,
+    const QuotientBitWidths&);
+template
+QuotientSelector<ArithShare> make_min_tie_selector(const T2BConverter<ArithShare>&,
+    const QuotientBitWidths&);
+
+template <class ShareT>
+QuotientSelector<ShareT> make_min_tie_selector(const T2BConverter<ShareT>& to_bool,
+    const size_t den_bits) {
+  return make_min_tie_selector(to_bool, QuotientBitWidths{0, den_bits, 0});
 }
 
 template
@@ -325,31 +409,35 @@ QuotientSelector<BoolShare> make_min_selector(const T2BConverter<BoolShare>&);
 template
 QuotientSelector<ArithShare> make_min_selector(const T2BConverter<ArithShare>&);
 
-// TODO#13 If we can mux with ArithShares, use it here.
-ArithQuotient select_quotient(const ArithQuotient& a, const ArithQuotient& b,
-    const QuotientSelector<ArithShare>& op_select, const B2AConverter& to_arith) {
-  /* Old implementation uses bool muxing
-  BoolQuotient q = max(a, b, to_bool);
-  return {to_arith(q.num), to_arith(q.den)};
-  */
+ArithShare mux(const ArithShare& sel, const ArithShare& a, const ArithShare& b) {
+  return b + sel * (a - b);
+}
+
+ArithQuotient mux(const ArithShare& sel, const ArithQuotient& a,
+    const ArithQuotient& b) {
   uint32_t nvals  = a.num.get_nvals();
+  assert(sel.get_nvals() == nvals);
   assert(a.den.get_nvals() == nvals);
   assert(b.num.get_nvals() == nvals);
   assert(b.den.get_nvals() == nvals);
+  // [num, den] in one SIMD share, so the selection costs a single MUL gate
+  const auto sel2 = vcombine<ArithShare>({sel, sel});
+  const auto a2 = vcombine<ArithShare>({a.num, a.den});
+  const auto b2 = vcombine<ArithShare>({b.num, b.den});
+  auto selected = mux(sel2, a2, b2).split(nvals);
+  return {move(selected[0]), move(selected[1])};
+}
+
+ArithQuotient select_quotient(const ArithQuotient& a, const ArithQuotient& b,
+    const QuotientSelector<ArithShare>& op_select, const B2AConverter& to_arith) {
   const auto cmp = op_select(a, b);
   ArithShare acmp = to_arith(cmp);
-  ArithmeticCircuit* acirc = acmp.get_circuit();
-  ArithShare one = constant_simd(acirc, 1u, acirc->GetShareBitLen(), nvals);
-  ArithShare notcmp = one - acmp;
 #ifdef DEBUG_SEL_GADGETS
   print_share(cmp, "select_quotient cmp");
   print_share(acmp, "select_quotient acmp");
-  print_share(notcmp, "select_quotient notcmp");
 #endif
 
-  ArithShare num = acmp * a.num + notcmp * b.num;
-  ArithShare den = acmp * a.den + notcmp * b.den;
-  return {move(num), move(den)};
+  return mux(acmp, a, b);
 }
 
 BoolQuotient select_quotient(const BoolQuotient& a, const BoolQuotient& b,
@@ -409,14 +497,16 @@ BoolQuotient max(const ArithQuotient& a, const ArithQuotient& b,
 }
 
 BoolShare ascending_numbers_constant(BooleanCircuit* bcirc,
-    size_t nvals, size_t start) {
+    size_t nvals, size_t start, size_t bitlen) {
   // TODO Make true SIMD constants available in ABY and implement offline
   // AND with constant
   vector<BoolShare> numbers;
   numbers.reserve(nvals);
   size_t end = nvals + start;
+  if (!bitlen) bitlen = ceil_log2_min1(end);
+  assert (bitlen >= ceil_log2_min1(end));
   for (size_t i = start; i != end; ++i) {
-    numbers.emplace_back(constant(bcirc, i, ceil_log2_min1(end)));
+    numbers.emplace_back(constant(bcirc, i, bitlen));
   }
   return vcombine<BoolShare>(numbers);
 }
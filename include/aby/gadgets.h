@@ -37,6 +37,13 @@ template <class ShareT>
 template <class ShareT>
   using QuotientSelector = std::function<BoolShare (const Quotient<ShareT>&, const Quotient<ShareT>&)>;
 
+/**
+ * Maximum bit widths of the numerators and denominators of quotients, and of
+ * any value at all, i.e., the bitlen of the circuit. 0 means unknown, in which
+ * case the bitlens of the shares are used.
+ */
+struct QuotientBitWidths { size_t num{0}, den{0}, max{0}; };
+
 template <class ShareT>
   using T2BConverter = std::function<BoolShare (const ShareT&)>;
 using A2BConverter = std::function<BoolShare (const ArithShare&)>;
@@ -58,6 +65,14 @@ void print_share(const Quotient<ShareT>& q, const std::string& msg);
  */
 BoolShare split_accumulate(BoolShare simd_share, const BinaryOp<BoolShare>& op);
 
+/**
+ * Like split_accumulate, but accumulates each of the consecutive segments of
+ * the given size independently, all segments in parallel. Returns a share with
+ * one value per segment.
+ */
+BoolShare segmented_accumulate(BoolShare simd_share, size_t segment_size,
+    const BinaryOp<BoolShare>& op);
+
 /**
  * Like split_accumulate but more specific to running a selector op_select which
  * returns a share with only one wire. This share is then muxed to select either
@@ -80,9 +95,34 @@ template <class ShareT>
 QuotientSelector<ShareT> make_min_tie_selector(const T2BConverter<ShareT>& to_bool,
     const size_t den_bits = 0);
 
+/**
+ * Tie selectors, whose boolean cross products and denominators are only as
+ * wide as the given widths of the compared quotients need.
+ */
+template <class ShareT>
+QuotientSelector<ShareT> make_max_tie_selector(const T2BConverter<ShareT>& to_bool,
+    const QuotientBitWidths& widths);
+template <class ShareT>
+QuotientSelector<ShareT> make_min_tie_selector(const T2BConverter<ShareT>& to_bool,
+    const QuotientBitWidths& widths);
+
 template <class ShareT>
 ShareT sum(const std::vector<ShareT>&);
 
+/**
+ * Arithmetic multiplexer: sel ? a : b, where sel is an arithmetic share of a
+ * single bit. Calculated as b + sel*(a-b), so only one multiplication is needed.
+ */
+ArithShare mux(const ArithShare& sel, const ArithShare& a, const ArithShare& b);
+
+/**
+ * Selects quotient a where sel is 1 and b otherwise, where sel is an arithmetic
+ * share of a single bit. Numerators and denominators are muxed in a single
+ * SIMD multiplication.
+ */
+ArithQuotient mux(const ArithShare& sel, const ArithQuotient& a,
+    const ArithQuotient& b);
+
 BoolQuotient max_tie(const std::vector<BoolQuotient>& qs);
 
 ArithQuotient max_tie(const std::vector<ArithQuotient>& qs,
@@ -98,8 +138,12 @@ ArithQuotient max(const ArithQuotient& a, const ArithQuotient& b,
 ArithQuotient max(const std::vector<ArithQuotient>& qs,
     const A2BConverter& to_bool, const B2AConverter& to_arith);
 
+/**
+ * SIMD constant of the numbers start, ..., start+nvals-1. If bitlen is 0, the
+ * minimal bitlen to hold all numbers is used.
+ */
 BoolShare ascending_numbers_constant(BooleanCircuit* bcirc,
-    size_t nvals, size_t start = 0);
+    size_t nvals, size_t start = 0, size_t bitlen = 0);
 
 } // namespace sel
 #endif /* end of include guard: SEL_ABY_GADGETS_H */
@@ -0,0 +1,191 @@
+/**
+ \file    sel/aby/gate_file.cpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief In-memory representation of ABY circuit files
+*/
+
+#include "gate_file.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+#include <fmt/format.h>
+#include "abycore/circuit/booleancircuits.h"
+
+using namespace std;
+
+namespace sel {
+
+GateFile::GateFile(const string& filename) {
+  ifstream file{filename};
+  if (!file.is_open()) {
+    throw runtime_error(fmt::format("Could not open circuit file {}", filename));
+  }
+
+  // File wire ids may be negative and sparse
+  map<long long, uint32_t> ids;
+  const auto dense_id = [&ids, this](long long id) {
+    const auto [it, inserted] = ids.try_emplace(id, num_wires);
+    if (inserted) ++num_wires;
+    return it->second;
+  };
+  // Inputs need to be numbered first, but are all listed before any gate
+  const auto in_id = [&ids, &filename](long long id) {
+    const auto it = ids.find(id);
+    if (it == ids.cend()) {
+      throw runtime_error(fmt::format(
+            "Circuit file {} uses undefined wire {}", filename, id));
+    }
+    return it->second;
+  };
+
+  string line;
+  vector<long long> tokens;
+  while (getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+
+    istringstream ls{line.substr(1)};
+    tokens.clear();
+    for (long long t; ls >> t; ) tokens.emplace_back(t);
+
+    switch (line[0]) {
+      case 'S': case 'C':
+        assert (gates.empty() && "Inputs must be listed before gates.");
+        for (const auto t : tokens) dense_id(t);
+        num_inputs_ += tokens.size();
+        break;
+      case '0':
+        gates.push_back({GateType::ZERO, 0, 0, 0, dense_id(tokens.at(0))});
+        break;
+      case '1':
+        gates.push_back({GateType::ONE, 0, 0, 0, dense_id(tokens.at(0))});
+        break;
+      case 'A':
+        gates.push_back({GateType::AND, in_id(tokens.at(0)), in_id(tokens.at(1)),
+            0, dense_id(tokens.at(2))});
+        break;
+      case 'X':
+        gates.push_back({GateType::XOR, in_id(tokens.at(0)), in_id(tokens.at(1)),
+            0, dense_id(tokens.at(2))});
+        break;
+      case 'V':
+        gates.push_back({GateType::OR, in_id(tokens.at(0)), in_id(tokens.at(1)),
+            0, dense_id(tokens.at(2))});
+        break;
+      case 'M':
+        gates.push_back({GateType::MUX, in_id(tokens.at(0)), in_id(tokens.at(1)),
+            in_id(tokens.at(2)), dense_id(tokens.at(3))});
+        break;
+      case 'I':
+        gates.push_back({GateType::INV, in_id(tokens.at(0)), 0, 0,
+            dense_id(tokens.at(1))});
+        break;
+      case 'O':
+        for (const auto t : tokens) outputs.emplace_back(in_id(t));
+        break;
+      default:
+        throw runtime_error(fmt::format(
+              "Unknown gate type '{}' in circuit file {}", line[0], filename));
+    }
+  }
+}
+
+vector<uint32_t> GateFile::put_gates(BooleanCircuit* bcirc,
+    const vector<uint32_t>& inputs, uint32_t nvals) const {
+  if (inputs.size() < num_inputs_) {
+    throw invalid_argument(fmt::format("Circuit file needs {} input wires "
+          "but only {} were given.", num_inputs_, inputs.size()));
+  }
+
+  vector<uint32_t> wires(num_wires);
+  copy_n(inputs.cbegin(), num_inputs_, wires.begin());
+
+  for (const auto& g : gates) {
+    switch (g.type) {
+      case GateType::ZERO:
+        wires[g.out] = bcirc->PutConstantGate(0, nvals);
+        break;
+      case GateType::ONE:
+        wires[g.out] = bcirc->PutConstantGate(1, nvals);
+        break;
+      case GateType::AND:
+        wires[g.out] = bcirc->PutANDGate(wires[g.in0], wires[g.in1]);
+        break;
+      case GateType::XOR:
+        wires[g.out] = bcirc->PutXORGate(wires[g.in0], wires[g.in1]);
+        break;
+      case GateType::OR:
+        wires[g.out] = bcirc->PutORGate(wires[g.in0], wires[g.in1]);
+        break;
+      case GateType::MUX:
+        // Same wire order as in ABY's PutGateFromFile()
+        wires[g.out] = bcirc->PutVecANDMUXGate(wires[g.in1], wires[g.in0], wires[g.in2]);
+        break;
+      case GateType::INV:
+        wires[g.out] = bcirc->PutINVGate(wires[g.in0]);
+        break;
+    }
+  }
+
+  vector<uint32_t> out;
+  out.reserve(outputs.size());
+  for (const auto o : outputs) out.emplace_back(wires[o]);
+  return out;
+}
+
+size_t GateFile::num_and_gates() const {
+  return count_if(gates.cbegin(), gates.cend(),
+      [](const Gate& g) { return g.type == GateType::AND || g.type == GateType::OR
+        || g.type == GateType::MUX; });
+}
+
+size_t GateFile::and_depth() const {
+  vector<size_t> depth(num_wires, 0);
+  for (const auto& g : gates) {
+    switch (g.type) {
+      case GateType::ZERO: case GateType::ONE:
+        break;
+      case GateType::XOR:
+        depth[g.out] = max(depth[g.in0], depth[g.in1]);
+        break;
+      case GateType::INV:
+        depth[g.out] = depth[g.in0];
+        break;
+      case GateType::MUX:
+        depth[g.out] = max({depth[g.in0], depth[g.in1], depth[g.in2]}) + 1;
+        break;
+      default: // AND, OR
+        depth[g.out] = max(depth[g.in0], depth[g.in1]) + 1;
+    }
+  }
+  size_t max_depth = 0;
+  for (const auto o : outputs) max_depth = max(max_depth, depth[o]);
+  return max_depth;
+}
+
+shared_ptr<const GateFile> get_cached_gate_file(const string& filename) {
+  static mutex cache_mutex;
+  static map<string, shared_ptr<const GateFile>> cache;
+
+  lock_guard<mutex> lock(cache_mutex);
+  auto& entry = cache[filename];
+  if (!entry) entry = make_shared<const GateFile>(filename);
+  return entry;
+}
+
+} // namespace sel
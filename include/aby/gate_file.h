@@ -0,0 +1,81 @@
+/**
+ \file    sel/aby/gate_file.h
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief In-memory representation of ABY circuit files
+*/
+
+#ifndef SEL_ABY_GATE_FILE_H
+#define SEL_ABY_GATE_FILE_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+class BooleanCircuit;
+
+namespace sel {
+
+/**
+ * A parsed circuit file in the format of ABY's PutGateFromFile().
+ * Wire ids are renumbered densely, inputs first, so that instantiating the
+ * circuit only needs a flat wire vector instead of parsing the file again.
+ */
+class GateFile {
+public:
+  enum class GateType : uint8_t { ZERO, ONE, AND, XOR, OR, MUX, INV };
+
+  struct Gate {
+    GateType type;
+    uint32_t in0, in1, in2; // unused inputs are 0
+    uint32_t out;
+  };
+
+  /**
+   * Parses the given file. Throws runtime_error if it cannot be read or
+   * contains unknown gates.
+   */
+  explicit GateFile(const std::string& filename);
+
+  /**
+   * Puts all gates into the given circuit, with the inputs mapped to the
+   * circuit's input wires in order of appearance, and returns the output wires.
+   * Equivalent to bcirc->PutGateFromFile(filename, inputs, nvals).
+   */
+  std::vector<uint32_t> put_gates(BooleanCircuit* bcirc,
+      const std::vector<uint32_t>& inputs, uint32_t nvals) const;
+
+  size_t num_inputs() const { return num_inputs_; }
+  size_t num_outputs() const { return outputs.size(); }
+  size_t num_gates() const { return gates.size(); }
+  size_t num_and_gates() const;
+  size_t and_depth() const;
+
+private:
+  size_t num_inputs_{0};
+  size_t num_wires{0};
+  std::vector<Gate> gates;
+  std::vector<uint32_t> outputs;
+};
+
+/**
+ * Returns the parsed circuit file, parsing it only on first use. Thread-safe.
+ */
+std::shared_ptr<const GateFile> get_cached_gate_file(const std::string& filename);
+
+} // namespace sel
+
+#endif /* end of include guard: SEL_ABY_GATE_FILE_H */
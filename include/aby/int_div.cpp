@@ -0,0 +1,201 @@
+/**
+ \file    sel/aby/int_div.cpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Generator for fixed-point integer division circuits
+*/
+
+#include "int_div.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace sel {
+
+namespace {
+
+/**
+ * Puts the gates into an ABY BooleanCircuit
+ */
+class ABYBackend {
+public:
+  using Wire = uint32_t;
+
+  ABYBackend(BooleanCircuit* bc, uint32_t nvals) :
+    bc{bc}, zero{bc->PutConstantGate(0, nvals)}, one{bc->PutConstantGate(1, nvals)} {}
+
+  Wire XOR(Wire a, Wire b) { return bc->PutXORGate(a, b); }
+  Wire AND(Wire a, Wire b) { return bc->PutANDGate(a, b); }
+  Wire INV(Wire a) { return bc->PutINVGate(a); }
+  Wire constant(bool v) const { return v ? one : zero; }
+
+private:
+  BooleanCircuit* bc;
+  const Wire zero, one;
+};
+
+/**
+ * Only counts AND gates. A wire is its AND depth.
+ */
+class CountingBackend {
+public:
+  using Wire = size_t;
+
+  Wire XOR(Wire a, Wire b) { return max(a, b); }
+  Wire AND(Wire a, Wire b) { ++and_gates; return max(a, b) + 1; }
+  Wire INV(Wire a) { return a; }
+  Wire constant(bool) const { return 0; }
+
+  size_t and_gates{0};
+};
+
+template <class Backend>
+using Wires = vector<typename Backend::Wire>;
+
+/**
+ * Ripple-carry adder: w-1 AND gates, depth w-1. Discards the carry-out.
+ */
+template <class Backend>
+Wires<Backend> ripple_add(Backend& b, const Wires<Backend>& x,
+    const Wires<Backend>& y, typename Backend::Wire cin) {
+  const size_t w = x.size();
+  assert (y.size() == w);
+  Wires<Backend> s(w);
+  auto c = cin;
+  for (size_t j = 0; j != w; ++j) {
+    s[j] = b.XOR(b.XOR(x[j], y[j]), c);
+    if (j + 1 != w) c = b.XOR(c, b.AND(b.XOR(x[j], c), b.XOR(y[j], c)));
+  }
+  return s;
+}
+
+/**
+ * Sklansky parallel-prefix adder: depth ceil(log2(w))+1. Discards the
+ * carry-out. Generate and propagate signals of disjoint groups are combined
+ * with XOR instead of OR, as they can't both be set.
+ */
+template <class Backend>
+Wires<Backend> sklansky_add(Backend& b, const Wires<Backend>& x,
+    const Wires<Backend>& y, typename Backend::Wire cin) {
+  const size_t w = x.size();
+  assert (y.size() == w);
+  Wires<Backend> p(w), g(w);
+  for (size_t j = 0; j != w; ++j) {
+    p[j] = b.XOR(x[j], y[j]);
+    g[j] = b.AND(x[j], y[j]);
+  }
+  // Carry-in is treated as generate signal of bit -1
+  g[0] = b.XOR(g[0], b.AND(p[0], cin));
+
+  // Group generate/propagate. After all levels, gg[j] is the carry out of bit j.
+  // Only the carries of bits 0..w-2 are needed.
+  Wires<Backend> gg = g, gp = p;
+  for (size_t l = 1; l < w - 1; l <<= 1) {
+    const bool last_level = 2*l >= w - 1;
+    for (size_t j = l; j < w - 1; ++j) {
+      if (!(j & l)) continue;
+      const size_t k = (j & ~(2*l - 1)) + l - 1; // top of lower block
+      gg[j] = b.XOR(gg[j], b.AND(gp[j], gg[k]));
+      if (!last_level) gp[j] = b.AND(gp[j], gp[k]);
+    }
+  }
+
+  Wires<Backend> s(w);
+  s[0] = b.XOR(p[0], cin);
+  for (size_t j = 1; j != w; ++j) s[j] = b.XOR(p[j], gg[j-1]);
+  return s;
+}
+
+template <class Backend>
+Wires<Backend> add(Backend& b, const Wires<Backend>& x,
+    const Wires<Backend>& y, typename Backend::Wire cin,
+    DivisionOptimization opt) {
+  return (opt == DivisionOptimization::SIZE) ?
+    ripple_add(b, x, y, cin) : sklansky_add(b, x, y, cin);
+}
+
+/**
+ * Non-restoring division of N = (x<<prec) + (y>>1) by y. As x <= y, the
+ * quotient has prec+1 bits, so the remainder can start with the upper bits
+ * N>>(prec+1) < y and only prec+1 steps are needed.
+ * The remainder is kept in two's complement with bits+2 bits. The quotient bits
+ * are the inverted signs of the partial remainders.
+ */
+template <class Backend>
+Wires<Backend> int_div_wires(Backend& b, const Wires<Backend>& x,
+    const Wires<Backend>& y, size_t bits, size_t prec,
+    DivisionOptimization opt) {
+  assert (x.size() == bits && y.size() == bits);
+  const auto zero = b.constant(false);
+
+  // N = (x<<prec) + (y>>1). Bits below prec are just those of y>>1, and
+  // y>>1 has bits-1 bits, so an adder is only needed if they overlap with x.
+  const size_t nw = bits + prec + 1;
+  Wires<Backend> N(nw, zero);
+  for (size_t j = 0; j + 1 < bits && j < prec; ++j) N[j] = y[j+1];
+  Wires<Backend> xhigh(bits + 1, zero), yhigh(bits + 1, zero);
+  copy(x.cbegin(), x.cend(), xhigh.begin());
+  bool overlap = false;
+  for (size_t j = prec; j + 1 < bits; ++j) {
+    yhigh[j - prec] = y[j+1];
+    overlap = true;
+  }
+  const auto nhigh = overlap ? add(b, xhigh, yhigh, zero, opt) : xhigh;
+  copy(nhigh.cbegin(), nhigh.cend(), N.begin() + prec);
+
+  const size_t w = bits + 2;
+  Wires<Backend> R(w, zero), D(w, zero), op(w), shifted(w);
+  copy_n(N.cbegin() + prec + 1, bits, R.begin());
+  copy(y.cbegin(), y.cend(), D.begin());
+
+  Wires<Backend> q(prec + 1);
+  auto subtract = b.constant(true); // first remainder is non-negative
+  for (size_t i = prec + 1; i-- > 0; ) {
+    shifted[0] = N[i];
+    copy_n(R.cbegin(), w - 1, shifted.begin() + 1);
+    // R -= D if R >= 0, else R += D. Subtraction is addition of ~D+1.
+    for (size_t j = 0; j != w; ++j) op[j] = b.XOR(D[j], subtract);
+    R = add(b, shifted, op, subtract, opt);
+    q[i] = b.INV(R[w-1]);
+    subtract = q[i];
+  }
+
+  return q;
+}
+
+} // namespace
+
+BoolShare int_div(const BoolShare& x, const BoolShare& y,
+    size_t bits, size_t prec, DivisionOptimization opt) {
+  assert (x.get_nvals() == y.get_nvals());
+  auto x_wires = x.zeropad(bits).get()->get_wires();
+  auto y_wires = y.zeropad(bits).get()->get_wires();
+  x_wires.resize(bits);
+  y_wires.resize(bits);
+
+  ABYBackend backend{x.get_circuit(), x.get_nvals()};
+  return BoolShare{x.get_circuit(),
+    int_div_wires(backend, x_wires, y_wires, bits, prec, opt)};
+}
+
+DivisionCircuitStats int_div_stats(size_t bits, size_t prec,
+    DivisionOptimization opt) {
+  CountingBackend backend;
+  const Wires<CountingBackend> inputs(bits, 0);
+  const auto q = int_div_wires(backend, inputs, inputs, bits, prec, opt);
+  return {backend.and_gates, *max_element(q.cbegin(), q.cend())};
+}
+
+} // namespace sel
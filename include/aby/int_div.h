@@ -0,0 +1,61 @@
+/**
+ \file    sel/aby/int_div.h
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Generator for fixed-point integer division circuits
+*/
+
+#ifndef SEL_ABY_INT_DIV_H
+#define SEL_ABY_INT_DIV_H
+#pragma once
+
+#include "Share.h"
+
+namespace sel {
+
+/**
+ * SIZE: Ripple-carry adders, i.e., minimal number of AND gates. Use for Yao.
+ * DEPTH: Sklansky parallel-prefix adders, i.e., minimal AND depth. Use for GMW.
+ */
+enum class DivisionOptimization { SIZE, DEPTH };
+
+struct DivisionCircuitStats {
+  size_t and_gates; // including OR and MUX gates
+  size_t and_depth;
+};
+
+/**
+ * Rounding fixed-point integer division, as in the precomputed circuits in
+ * data/circ/sel_int_div:
+ *
+ *   x, y -> ((x<<prec) + (y>>1)) / y
+ *
+ * where x and y have at most the given bitlength and it is assumed that
+ * 0 < x/y <= 1. The result has prec+1 bits.
+ * The quotient is calculated by non-restoring division, so each of the prec+1
+ * quotient bits costs a single addition/subtraction.
+ */
+BoolShare int_div(const BoolShare& x, const BoolShare& y,
+    size_t bits, size_t prec, DivisionOptimization opt);
+
+/**
+ * AND gate count and depth of the circuit that int_div() generates, without
+ * building it.
+ */
+DivisionCircuitStats int_div_stats(size_t bits, size_t prec,
+    DivisionOptimization opt);
+
+} // namespace sel
+
+#endif /* end of include guard: SEL_ABY_INT_DIV_H */
@@ -23,6 +23,8 @@
 #pragma once
 
 #include "gadgets.h"
+#include <algorithm>
+#include <numeric>
 
 namespace sel {
 
@@ -32,12 +34,31 @@ class QuotientFolder {
 public:
   enum class FoldOp { MIN, MIN_TIE, MAX, MAX_TIE };
 
+  /**
+   * The selector and targets are interpreted as consecutive segments of the
+   * given sizes, each of which gets folded independently. If no segment sizes
+   * are given, the whole share is a single segment. The folded leaf has one
+   * value per segment.
+   *
+   * Elements may be blocks of block_size consecutive SIMD values instead of
+   * single values, in which case segment sizes count blocks and the folded
+   * leaf has one block per segment. E.g., k quotients of n values each,
+   * vertically combined, are folded element-wise to n values with segments
+   * {k} and block_size n.
+   */
   QuotientFolder(Quotient<ShareT>&& selector, FoldOp _fold_op = FoldOp::MAX_TIE,
-      std::vector<BoolShare>&& targets = {})
+      std::vector<BoolShare>&& targets = {}, std::vector<size_t>&& _segments = {},
+      size_t _block_size = 1)
     : base{std::forward<Quotient<ShareT>>(selector),
            std::forward<std::vector<BoolShare>>(targets)},
-      fold_op{_fold_op}
+      fold_op{_fold_op}, segments{std::forward<std::vector<size_t>>(_segments)},
+      block_size{_block_size}
   {
+    assert (block_size > 0 && base.size() % block_size == 0);
+    if (segments.empty()) segments.push_back(base.size()/block_size);
+    assert (std::accumulate(segments.cbegin(), segments.cend(), size_t{0})
+        * block_size == base.size());
+    for ([[maybe_unused]] const auto s : segments) assert(s > 0);
     if constexpr (!do_conversion) {
       static const T2BConverter<BoolShare> bool_identity = [](auto x){return x;};
       to_bool = &bool_identity;
@@ -60,7 +81,16 @@ public:
     const size_t _den_bits = 0) {
       to_bool = _to_bool;
       to_arith = _to_arith;
-      den_bits = _den_bits;
+      widths.den = _den_bits;
+  }
+
+  /**
+   * Sets the maximum bit widths of the numerators and denominators, so that
+   * the tie selectors' boolean cross products and denominators are truncated
+   * to the bits the quotients actually use.
+   */
+  void set_bit_widths(const QuotientBitWidths& _widths) {
+    widths = _widths;
   }
 
   class Leaf {
@@ -101,16 +131,38 @@ public:
     Quotient<ShareT> selector;
     std::vector<BoolShare> targets;
 
-    bool odd_size() const { return size() % 2; }
+    /**
+     * Splits selector and targets into leaves of the given sizes
+     */
+    std::vector<Leaf> split(const std::vector<uint32_t>& sizes) const {
+      if (sizes.size() == 1) return {*this};
+      auto splits_num = selector.num.split(sizes);
+      auto splits_den = selector.den.split(sizes);
+      auto split_targets = transform_vec(targets,
+          [&sizes](const BoolShare& target) { return target.split(sizes); });
+
+      std::vector<Leaf> leaves;
+      leaves.reserve(sizes.size());
+      for (size_t i = 0; i != sizes.size(); ++i) {
+        leaves.emplace_back(slice_vec(splits_num, splits_den, split_targets, i));
+      }
+      return leaves;
+    }
 
-    Leaf& append(const Leaf& other) {
-      selector.num = vcombine<ShareT>({selector.num, other.selector.num});
-      selector.den = vcombine<ShareT>({selector.den, other.selector.den});
-      assert (targets.size() == other.targets.size());
-      for(size_t i=0; i!=targets.size(); ++i) {
-        targets[i] = vcombine<BoolShare>({targets[i], other.targets[i]});
+    /**
+     * Vertically combines all given leaves into a single leaf
+     */
+    static Leaf combine(const std::vector<Leaf>& leaves) {
+      if (leaves.size() == 1) return leaves[0];
+      auto nums = transform_vec(leaves, [](const Leaf& l) { return l.selector.num; });
+      auto dens = transform_vec(leaves, [](const Leaf& l) { return l.selector.den; });
+      std::vector<BoolShare> targets;
+      targets.reserve(leaves.at(0).targets.size());
+      for (size_t i = 0; i != leaves[0].targets.size(); ++i) {
+        targets.emplace_back(vcombine<BoolShare>(transform_vec(leaves,
+              [&i](const Leaf& l) { return l.targets[i]; })));
       }
-      return *this;
+      return {{vcombine<ShareT>(nums), vcombine<ShareT>(dens)}, std::move(targets)};
     }
 
     /**
@@ -124,24 +176,32 @@ public:
     }
   };
 
+  /**
+   * Folds all segments in parallel: In each round, the first half of each
+   * segment is compared to its second half with a single SIMD selection over
+   * all segments. An odd element of a segment, as well as segments that are
+   * already folded, are passed on to the next round unchanged. So the depth is
+   * ceil(log2(largest segment)) rounds.
+   */
   Leaf fold() {
     auto op_select = make_selector();
 
-    while (base.size() > 1) {
-      split_half();
-      fold_once(other, op_select);
-      if (base.odd_size() && have_remainder()) append_remainder();
+    while (std::any_of(segments.cbegin(), segments.cend(),
+          [](size_t s){ return s > 1; })) {
+      fold_round(op_select);
     }
-    if (have_remainder()) fold_once(remainder, op_select);
+    assert (base.size() == segments.size() * block_size);
     return base;
   }
 
 private:
-  Leaf base, other, remainder;
+  Leaf base;
   FoldOp fold_op;
+  std::vector<size_t> segments;
+  size_t block_size;
   T2BConverter<ShareT> const* to_bool = nullptr;
   B2AConverter const* to_arith = nullptr;
-  size_t den_bits = 0;
+  QuotientBitWidths widths;
 
   QuotientSelector<ShareT> make_selector() {
     switch (fold_op) {
@@ -150,58 +210,78 @@ private:
       case FoldOp::MAX:
         return make_max_selector(*to_bool);
       case FoldOp::MIN_TIE:
-        return make_min_tie_selector(*to_bool, den_bits);
+        return make_min_tie_selector(*to_bool, widths);
       default: // MAX_TIE is default
-        return make_max_tie_selector(*to_bool, den_bits);
+        return make_max_tie_selector(*to_bool, widths);
     }
   }
 
-  bool have_remainder() const { return remainder.size() > 0; }
-  void append_remainder() {
+  void fold_round(const QuotientSelector<ShareT>& op_select) {
+    // Split layout: [half, half, (odd)] for segments to fold, [1] for done
+    // ones, all in blocks
+    const uint32_t block = block_size;
+    std::vector<uint32_t> sizes, halves;
+    bool pass_through = false;
+    for (const auto s : segments) {
+      if (s > 1) {
+        const uint32_t half = s/2 * block;
+        sizes.insert(sizes.end(), {half, half});
+        halves.push_back(half);
+        if (s%2) {
+          sizes.push_back(block);
+          pass_through = true;
+        }
+      } else {
+        sizes.push_back(block);
+        pass_through = true;
+      }
+    }
 #ifdef DEBUG_SEL_GADGETS
-    std::cout << ">> appending remainder\n";
+    std::cout << "> Folding " << segments.size() << " segments of total size "
+      << base.size() << ", " << halves.size() << " of which are active\n";
 #endif
-    base.append(remainder);
-    remainder.reset();
-  }
+    auto parts = base.split(sizes);
 
-  void split_half() {
-    size_t half_size = base.size()/2;
-#ifdef DEBUG_SEL_GADGETS
-    std::cout << "> Splitting " << base.size() << " to " << half_size
-      << " % " << base.size()%2 << '\n';
-#endif
-    auto splits_num = base.selector.num.split(half_size);
-    auto splits_den = base.selector.den.split(half_size);
-    auto split_targets = transform_vec(base.targets,
-        [&half_size](const BoolShare& target) { return target.split(half_size); });
-
-    base = Leaf::slice_vec(splits_num, splits_den, split_targets, 0);
-    other = Leaf::slice_vec(splits_num, splits_den, split_targets, 1);
-    assert (base.size() == half_size);
-    assert (other.size() == half_size);
-    // check remainder
-    if (splits_num.size() > 2) {
-#ifdef DEBUG_SEL_GADGETS
-      std::cout << ">> setting split remainder\n";
-#endif
-      assert (splits_num.size() == 3);
-      assert (splits_den.size() == 3);
-      remainder = Leaf::slice_vec(splits_num, splits_den, split_targets, 2);
-      assert (remainder.size() == 1);
+    std::vector<Leaf> lefts, rights;
+    lefts.reserve(halves.size());
+    rights.reserve(halves.size());
+    for (size_t i = 0, p = 0; i != segments.size(); ++i) {
+      if (segments[i] > 1) {
+        lefts.emplace_back(std::move(parts[p++]));
+        rights.emplace_back(std::move(parts[p++]));
+        if (segments[i]%2) ++p;
+      } else {
+        ++p;
+      }
+    }
+    base = Leaf::combine(lefts);
+    fold_once(Leaf::combine(rights), op_select);
+
+    if (pass_through) {
+      // Re-insert odd elements and folded segments in segment order
+      auto folded = base.split(halves);
+      std::vector<Leaf> merged;
+      merged.reserve(sizes.size());
+      for (size_t i = 0, p = 0, k = 0; i != segments.size(); ++i) {
+        if (segments[i] > 1) {
+          merged.emplace_back(std::move(folded[k++]));
+          p += 2;
+          if (segments[i]%2) merged.emplace_back(std::move(parts[p++]));
+        } else {
+          merged.emplace_back(std::move(parts[p++]));
+        }
+      }
+      base = Leaf::combine(merged);
     }
+
+    for (auto& s : segments) s = s/2 + s%2;
   }
 
   void fold_once(const Leaf& with, const QuotientSelector<ShareT>& op_select) {
     assert(base.size() == with.size());
     auto selection = op_select(base.selector, with.selector);
     if constexpr (do_conversion) {
-      ArithShare arith_sel = (*to_arith)(selection);
-      ArithmeticCircuit* ac = base.selector.num.get_circuit();
-      ArithShare one = constant_simd(ac, 1u, ac->GetShareBitLen(), base.size());
-      ArithShare not_sel = one - arith_sel;
-      base.selector.num = arith_sel * base.selector.num + not_sel * with.selector.num;
-      base.selector.den = arith_sel * base.selector.den + not_sel * with.selector.den;
+      base.selector = mux((*to_arith)(selection), base.selector, with.selector);
     } else {
       base.selector.num = selection.mux(base.selector.num, with.selector.num);
       base.selector.den = selection.mux(base.selector.den, with.selector.den);
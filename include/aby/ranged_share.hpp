@@ -0,0 +1,195 @@
+/**
+ \file    sel/aby/ranged_share.hpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Shares with tracked maximum bit widths of their values
+*/
+
+#ifndef SEL_ABY_RANGED_SHARE_H
+#define SEL_ABY_RANGED_SHARE_H
+#pragma once
+
+#include "gadgets.h"
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+#include <vector>
+
+namespace sel {
+
+/**
+ * A share whose values are known to fit into bits() many bits, but never more
+ * than max_bits(), the bitlen of the circuit.
+ *
+ * Operations on ranged shares propagate the width: a sum needs one bit more
+ * than its wider summand, a product as many bits as both factors together.
+ * Boolean shares are truncated to their width, so that the adders,
+ * multipliers, muxes and comparators built on them only get as many wires as
+ * the values can actually use, instead of the circuit's full bitlen. Operands
+ * are zeropadded to the result width first, so that no carry gets lost.
+ *
+ * Arithmetic shares always occupy the whole ring, so their width is only
+ * tracked, e.g., to truncate them after a conversion into boolean space.
+ */
+template <class ShareT>
+class Ranged {
+  static constexpr bool is_bool = std::is_same_v<ShareT, BoolShare>;
+public:
+  Ranged() = default;
+  Ranged(ShareT share, size_t bits, size_t max_bits) :
+    bits_{std::min(bits, max_bits)}, max_bits_{max_bits},
+    sh{truncated(std::move(share), bits_)} {}
+
+  const ShareT& get() const { return sh; }
+  size_t bits() const { return bits_; }
+  size_t max_bits() const { return max_bits_; }
+  uint32_t get_nvals() const { return sh.get_nvals(); }
+  bool is_null() const { return sh.is_null(); }
+
+  /**
+   * Returns the share, zeropadded to the given bitlen if it is boolean and
+   * narrower.
+   */
+  ShareT padded(size_t bitlen) const {
+    if constexpr (is_bool) {
+      if (sh.get_bitlen() < bitlen) return sh.zeropad(bitlen);
+    }
+    return sh;
+  }
+
+  /**
+   * Boolean left shift, which widens the share instead of dropping its most
+   * significant bits
+   */
+  Ranged shifted_left(size_t shift) const {
+    static_assert(is_bool, "Only boolean shares can be shifted.");
+    auto bcirc = sh.get_circuit();
+    std::vector<uint32_t> wires(shift, bcirc->PutConstantGate(0, sh.get_nvals()));
+    const auto& in = sh.get()->get_wires();
+    wires.insert(wires.end(), in.cbegin(), in.cend());
+    return {BoolShare{bcirc, wires}, bits_ + shift, max_bits_};
+  }
+
+  friend Ranged operator+(const Ranged& a, const Ranged& b) {
+    const size_t bits = a.capped(std::max(a.bits_, b.bits_) + 1);
+    return {a.padded(bits) + b.padded(bits), bits, a.max_bits_};
+  }
+
+  friend Ranged operator*(const Ranged& a, const Ranged& b) {
+    // A single bit only selects the other factor
+    if (a.bits_ == 1) return b.selected_by(a.sh);
+    if (b.bits_ == 1) return a.selected_by(b.sh);
+    const size_t bits = a.capped(a.bits_ + b.bits_);
+    return {a.padded(bits) * b.padded(bits), bits, a.max_bits_};
+  }
+
+  /**
+   * Boolean comparisons of both shares, zeropadded to the wider one
+   */
+  friend BoolShare operator<(const Ranged& a, const Ranged& b) {
+    const size_t bits = std::max(a.bits_, b.bits_);
+    return a.padded(bits) < b.padded(bits);
+  }
+
+  friend BoolShare operator>(const Ranged& a, const Ranged& b) {
+    return b < a;
+  }
+
+  friend BoolShare operator==(const Ranged& a, const Ranged& b) {
+    const size_t bits = std::max(a.bits_, b.bits_);
+    return a.padded(bits) == b.padded(bits);
+  }
+
+  /**
+   * Boolean multiplexer: sel ? a : b, only as wide as the wider of both
+   */
+  friend Ranged mux(const BoolShare& selection, const Ranged& a, const Ranged& b) {
+    const size_t bits = std::max(a.bits_, b.bits_);
+    return {selection.mux(a.padded(bits), b.padded(bits)), bits, a.max_bits_};
+  }
+
+private:
+  size_t bits_{0}, max_bits_{0};
+  ShareT sh;
+
+  size_t capped(size_t bits) const { return std::min(bits, max_bits_); }
+
+  static ShareT truncated(ShareT share, size_t bits) {
+    if constexpr (is_bool) {
+      if (!share.is_null() && share.get_bitlen() > bits) return share.truncate(bits);
+    }
+    return share;
+  }
+
+  /**
+   * This share where bit is set, zero otherwise. Boolean shares take one AND
+   * gate per bit instead of a multiplier.
+   */
+  Ranged selected_by(const ShareT& bit) const {
+    if constexpr (is_bool) {
+      assert (bit.get_bitlen() == 1);
+      const BoolShare bits{bit.get_circuit(),
+        std::vector<uint32_t>(sh.get_bitlen(), bit.get()->get_wires()[0])};
+      return {bits & sh, bits_, max_bits_};
+    } else {
+      return {bit * sh, bits_, max_bits_};
+    }
+  }
+};
+
+/**
+ * Sums up all shares pairwise, so that the width grows by ceil(log2(n)) bits
+ */
+template <class ShareT>
+Ranged<ShareT> sum(const std::vector<Ranged<ShareT>>& shares) {
+  assert (!shares.empty());
+  std::vector<Ranged<ShareT>> sums{shares};
+  while (sums.size() > 1) {
+    std::vector<Ranged<ShareT>> next;
+    next.reserve((sums.size() + 1)/2);
+    for (size_t i = 0; i + 1 < sums.size(); i += 2) {
+      next.emplace_back(sums[i] + sums[i+1]);
+    }
+    if (sums.size() % 2) next.emplace_back(std::move(sums.back()));
+    sums = std::move(next);
+  }
+  return sums.front();
+}
+
+/**
+ * Vertically combines the shares, zeropadded to the widest one
+ */
+template <class ShareT>
+Ranged<ShareT> vcombine(const std::vector<Ranged<ShareT>>& shares) {
+  assert (!shares.empty());
+  size_t bits = 0;
+  for (const auto& s : shares) bits = std::max(bits, s.bits());
+  std::vector<ShareT> padded;
+  padded.reserve(shares.size());
+  for (const auto& s : shares) padded.emplace_back(s.padded(bits));
+  return {vcombine<ShareT>(padded), bits, shares.front().max_bits()};
+}
+
+/**
+ * Converts the share into boolean space, truncated to its width
+ */
+template <class ShareT>
+Ranged<BoolShare> converted(const Ranged<ShareT>& s,
+    const T2BConverter<ShareT>& to_bool) {
+  return {to_bool(s.get()), s.bits(), s.max_bits()};
+}
+
+} // namespace sel
+
+#endif /* end of include guard: SEL_ABY_RANGED_SHARE_H */
@@ -92,12 +92,19 @@ std::string base64_encode(uint8_t const* buf, unsigned int bufLen) {
 }
 
 std::vector<uint8_t> base64_decode(std::string const& encoded_string, unsigned int buff_length) {
+  std::vector<uint8_t> ret;
+  base64_decode(encoded_string, buff_length, ret);
+  return ret;
+}
+
+void base64_decode(std::string const& encoded_string, unsigned int buff_length,
+    std::vector<uint8_t>& ret) {
   int in_len = encoded_string.size();
   int i = 0;
   int j = 0;
   int in_ = 0;
   uint8_t char_array_4[4], char_array_3[3];
-  std::vector<uint8_t> ret;
+  ret.clear();
 
   while (in_len-- && (encoded_string[in_] != '=') &&
          is_base64(encoded_string[in_])) {
@@ -138,8 +145,6 @@ std::vector<uint8_t> base64_decode(std::string const& encoded_string, unsigned i
   for (unsigned k = 0; k != bytediff; ++k){
     ret.emplace_back(0x00);
   }
-
-  return ret;
 }
 
 std::string print_bytearray(const std::vector<uint8_t>& array) {
@@ -40,6 +40,8 @@
 
 std::string base64_encode(uint8_t const* buf, unsigned int bufLen);
 std::vector<uint8_t> base64_decode(std::string const&, unsigned int);
+// Decodes into ret, reusing its memory
+void base64_decode(std::string const&, unsigned int, std::vector<uint8_t>& ret);
 std::string print_bytearray(const std::vector<uint8_t>&);
 std::string print_byte(uint8_t);
 
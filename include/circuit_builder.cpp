@@ -25,6 +25,10 @@ using fmt::format;
 #include "logger.h"
 #include "aby/Share.h"
 #include "aby/quotient_folder.hpp"
+#include "aby/ranged_share.hpp"
+#include "aby/int_div.h"
+#include "linkage_plan.h"
+#include <filesystem>
 
 using namespace std;
 
@@ -36,11 +40,11 @@ namespace sel {
   * w - weight for weight sum = weight * empyt-deltas
   */
 template <class MultShare>
-struct FieldWeight { MultShare fw, w; };
+struct FieldWeight { Ranged<MultShare> fw, w; };
 
 template <class MultShare>
 struct LinkageShares {
-  BoolShare index, match, tmatch;
+  BoolShare index, match_bits;
 #ifdef DEBUG_SEL_RESULT
   MultShare score_numerator, score_denominator;
 #endif
@@ -49,18 +53,18 @@ struct LinkageShares {
 #ifdef DEBUG_SEL_CIRCUIT
 template <class MultShare>
 void print_share(const FieldWeight<MultShare>& q, const string& msg) {
-  print_share(q.fw, msg + "(field-w)");
-  print_share(q.w, msg + "(weight)");
+  print_share(q.fw.get(), msg + "(field-w)");
+  print_share(q.w.get(), msg + "(weight)");
 }
 #endif
 
 /**
- * Sums all fw's and w's in given vector and returns sums as ArithQuotient
+ * Sums all fw's and w's in given vector and returns sums as Quotient
  */
 template <class MultShare>
-Quotient<MultShare> sum(const vector<FieldWeight<MultShare>>& fweights) {
+Quotient<Ranged<MultShare>> sum(const vector<FieldWeight<MultShare>>& fweights) {
   size_t size = fweights.size();
-  vector<MultShare> fws, ws;
+  vector<Ranged<MultShare>> fws, ws;
   fws.reserve(size);
   ws.reserve(size);
   for (const auto& fweight : fweights) {
@@ -70,6 +74,47 @@ Quotient<MultShare> sum(const vector<FieldWeight<MultShare>>& fweights) {
   return {sum(fws), sum(ws)};
 }
 
+/**
+ * Prepends one value of head to each of the head.nvals consecutive, equally
+ * sized segments of tail
+ */
+template <class ShareT>
+ShareT prepend_segments(const ShareT& head, const ShareT& tail) {
+  const size_t nseg = head.get_nvals();
+  if (nseg == 1) return vcombine<ShareT>({head, tail});
+
+  auto heads = head.split(1);
+  auto tails = tail.split(tail.get_nvals()/nseg);
+  vector<ShareT> parts;
+  parts.reserve(2*nseg);
+  for (size_t i = 0; i != nseg; ++i) {
+    parts.emplace_back(move(heads[i]));
+    parts.emplace_back(move(tails[i]));
+  }
+  return vcombine<ShareT>(parts);
+}
+
+/**
+ * Paths of the precomputed integer division circuits of all dice fields by
+ * their bitsize. Empty, unless the files are requested by use_int_div_files.
+ */
+map<size_t, string> find_int_div_files(const CircuitConfig& cfg) {
+  map<size_t, string> files;
+  if (!cfg.use_int_div_files) return files;
+  for (const auto& field : cfg.epi.field_specs) {
+    if (field.comparator != FieldComparator::DICE) continue;
+    const auto bitsize = hw_size(field.bitsize) + 1;
+    const auto path = cfg.circ_dir/format("sel_int_div/{}_{}.aby",
+        bitsize, cfg.dice_prec);
+    if (!std::filesystem::exists(path)) {
+      throw invalid_argument(format("No precomputed integer division circuit "
+            "{} for field {}.", path.string(), field.name));
+    }
+    files.emplace(bitsize, path.string());
+  }
+  return files;
+}
+
 /**
  * EpiLink Circuit Builder
  *
@@ -84,14 +129,21 @@ class CircuitBuilder : public CircuitBuilderBase {
 public:
   CircuitBuilder(CircuitConfig cfg_,
       BooleanCircuit* bcirc, BooleanCircuit* ccirc, ArithmeticCircuit* acirc) :
-    cfg{cfg_}, bcirc{bcirc}, ccirc{ccirc}, acirc{acirc},
+    cfg{cfg_}, plan{cfg}, bcirc{bcirc}, ccirc{ccirc}, acirc{acirc},
     ins{cfg, bcirc, acirc}, // CircuitInput
+    int_div_files{find_int_div_files(cfg)},
+    int_div_opt{(bcirc->GetContext() == S_YAO) ?
+      DivisionOptimization::SIZE : DivisionOptimization::DEPTH},
     to_bool_closure{[this](auto x){return to_bool(x);}},
     to_arith_closure{[this](auto x){return to_arith(x);}}
   {
     get_logger()->trace("CircuitBuilder created.");
   }
 
+  void set_chunk(ChunkInfo&& chunk) override {
+    ins.set_chunk(move(chunk));
+  }
+
   void set_input(const EpilinkClientInput& input) override {
     ins.set(input);
   }
@@ -112,9 +164,11 @@ public:
       throw new runtime_error("Set the input first before building the ciruit!");
     }
 
+    prepare_build();
+
     vector<LinkageOutputShares> output_shares;
-    output_shares.reserve(ins.nrecords());
-    for (size_t index = 0; index != ins.nrecords(); ++index) {
+    output_shares.reserve(ins.nrecord_shares());
+    for (size_t index = 0; index != ins.nrecord_shares(); ++index) {
       output_shares.emplace_back(
             to_linkage_output(build_single_linkage_circuit(index)));
     }
@@ -128,34 +182,61 @@ public:
       throw new runtime_error("Set the input first before building the ciruit!");
     }
 
-    vector<LinkageShares<MultShare>> linkage_shares;
-    linkage_shares.reserve(ins.nrecords());
-    for (size_t index = 0; index != ins.nrecords(); ++index) {
-      linkage_shares.emplace_back(build_single_linkage_circuit(index));
+    prepare_build();
+
+    vector<BoolShare> match_bits;
+    match_bits.reserve(ins.nrecord_shares());
+    for (size_t index = 0; index != ins.nrecord_shares(); ++index) {
+      match_bits.emplace_back(any_match(index));
+    }
+
+    built = true;
+    return sum_match_bits(match_bits);
+  }
+
+  std::vector<ChunkOutputShares> build_chunk_circuit() override {
+    if (!ins.is_input_set()) {
+      throw new runtime_error("Set the input first before building the ciruit!");
+    }
+
+    prepare_build();
+
+    vector<ChunkOutputShares> output_shares;
+    output_shares.reserve(ins.nrecord_shares());
+    for (size_t index = 0; index != ins.nrecord_shares(); ++index) {
+      output_shares.emplace_back(to_chunk_output(best_score(index)));
     }
 
     built = true;
-    return sum_linkage_shares(linkage_shares);
+    return output_shares;
   }
 
   void reset() override {
     ins.clear();
     field_weight_cache.clear();
+    comparison_cache.clear();
     built = false;
   }
 
 private:
   inline static constexpr bool do_arith_mult = std::is_same_v<MultShare, ArithShare>;
   using QuotientShare = Quotient<MultShare>;
+  using RangedQuotient = Quotient<Ranged<MultShare>>;
   using MultQuotientFolder = QuotientFolder<MultShare>;
 
   const CircuitConfig cfg;
+  const LinkagePlan plan;
   // Circuits
   BooleanCircuit* bcirc; // boolean circuit for boolean parts
   BooleanCircuit* ccirc; // intermediate conversion circuit
   ArithmeticCircuit* acirc;
   // Input shares
   CircuitInput<MultShare> ins;
+  // Integer division of dice coefficients: precomputed circuit files, if
+  // requested, or generated circuits, optimized for size in Yao and depth in
+  // GMW
+  const map<size_t, string> int_div_files;
+  const DivisionOptimization int_div_opt;
   // State
   bool built{false};
 
@@ -172,6 +253,16 @@ private:
     return (bcirc->GetContext() == S_YAO) ? y2b(ccirc, s) : s;
   }
 
+  /**
+   * Arithmetic shares can be output as-is, boolean shares should be XOR
+   */
+  MultShare to_out_space(const MultShare& s) {
+    if constexpr (do_arith_mult)
+      return s;
+    else
+      return to_gmw(s);
+  }
+
   BoolShare to_logic_space(const MultShare& s) {
     if constexpr (do_arith_mult)
       return to_bool(s);
@@ -179,6 +270,10 @@ private:
       return s;
   }
 
+  Ranged<BoolShare> to_logic_space(const Ranged<MultShare>& s) {
+    return {to_logic_space(s.get()), s.bits(), s.max_bits()};
+  }
+
   MultShare to_mult_space(const BoolShare& s) {
     if constexpr (do_arith_mult)
       return to_arith(s);
@@ -186,175 +281,311 @@ private:
       return s;
   }
 
+  /**
+   * Share whose values fit into the given bits. Boolean shares are truncated
+   * accordingly.
+   */
+  template <class ShareT>
+  Ranged<ShareT> ranged(ShareT s, size_t bits) const {
+    return {move(s), bits, cfg.bitlen};
+  }
+
   // closures
   const A2BConverter to_bool_closure;
   const B2AConverter to_arith_closure;
 
   /*
-  * Builds the record linkage component of the circuit
-  */
-  LinkageShares<MultShare> build_single_linkage_circuit(size_t index) {
-    get_logger()->trace("Building linkage circuit component {}...", index);
-
+   * Builds the scores of the current database (chunk) for record share index
+   */
+  RangedQuotient scores(size_t index) {
     // Where we store all group and individual comparison weights
     vector<FieldWeight<MultShare>> field_weights;
 
     // 1. Field weights of individual fields
     // 1.1 For all exchange groups, find the permutation with the highest score
-    // Where we collect indices not already used in an exchange group
-    IndexSet no_x_group;
-    // fill with field names, remove later
-    for (const auto& field : cfg.epi.fields) no_x_group.emplace(field.first);
-    // for each group, store the best permutation's weight into field_weights
-    for (const auto& group : cfg.epi.exchange_groups) {
-      // add this group's field weight to vector
+    // and store the best permutation's weight into field_weights
+    for (const auto& group : plan.exchange_groups) {
       field_weights.emplace_back(best_group_weight(index, group));
-      // remove all indices that were covered by this index group
-      for (const auto& i : group) no_x_group.erase(i);
     }
-    // 1.2 Remaining indices
-    for (const auto& i : no_x_group) {
-      field_weights.emplace_back(field_weight({index, i, i}));
+    // 1.2 Remaining indices not in any exchange group
+    for (const auto c : plan.single_comparisons) {
+      field_weights.emplace_back(field_weight(index, c));
     }
 
     // 2. Sum up all field weights.
-    QuotientShare sum_field_weights = sum(field_weights);
+    RangedQuotient sum_field_weights = sum(field_weights);
 #ifdef DEBUG_SEL_CIRCUIT
-    print_share(sum_field_weights, format("[{}] sum_field_weights", index));
+    print_share(sum_field_weights.num.get(), format("[{}] sum_field_weights (num)", index));
+    print_share(sum_field_weights.den.get(), format("[{}] sum_field_weights (den)", index));
 #endif
+    return sum_field_weights;
+  }
 
+  /*
+   * Determines the best score of the current database (chunk) for record share
+   * index and its index
+   */
+  auto best_score(size_t index) {
     // 3. Determine index of max score of all nvals calculations
-    const auto max_fw_and_index = max_index(move(sum_field_weights));
+    return max_index(scores(index), index);
+  }
+
+  /*
+   * Determines whether any score of the current database (chunk) exceeds the
+   * threshold and tentative threshold, as 2-bit match bits per segment.
+   * Counting doesn't need the best score nor its index, so instead of folding
+   * the scores, all of them are classified in a single SIMD circuit, followed
+   * by a segmented OR-reduction of both bits at once.
+   */
+  BoolShare any_match(size_t index) {
+    auto score = scores(index);
+    size_t segment_size = ins.dbsize();
+    if (ins.has_carry()) {
+      // The best score of all previous chunks matches iff any of them did
+      prepend_carry(score, index);
+      ++segment_size;
+    }
+
+    const auto match_bits = threshold_bands(score);
+    auto any = segmented_accumulate(match_bits, segment_size,
+        [](auto a, auto b) { return a | b; });
+#ifdef DEBUG_SEL_CIRCUIT
+    print_share(match_bits, format("[{}] match bits", index));
+    print_share(any, format("[{}] any (tentative) match?", index));
+#endif
+    return any;
+  }
+
+  /*
+  * Builds the record linkage component of the circuit
+  */
+  LinkageShares<MultShare> build_single_linkage_circuit(size_t index) {
+    get_logger()->trace("Building linkage circuit component {}...", index);
+
+    auto score = scores(index);
+    // The best score has the same widths as all scores
+    const size_t num_bits = score.num.bits(), den_bits = score.den.bits();
+    const auto max_fw_and_index = max_index(move(score), index);
     const auto max_field_weight = max_fw_and_index.get_selector();
     const auto max_idx = max_fw_and_index.get_targets();
 
-    // 4. Set two comparison bits, whether field-weight-sum > (tentative) threshold * weight-sum
-    BoolShare threshold_weight = to_logic_space(ins.const_threshold() * max_field_weight.den);
-    BoolShare tthreshold_weight = to_logic_space(ins.const_tthreshold() * max_field_weight.den);
-    BoolShare b_sum_field_weight = to_logic_space(max_field_weight.num);
-    BoolShare match = threshold_weight < b_sum_field_weight;
-    BoolShare tmatch = tthreshold_weight < b_sum_field_weight;
+    // 4. Classify, whether field-weight-sum > (tentative) threshold * weight-sum
+    auto match_bits = threshold_bands({ranged(max_field_weight.num, num_bits),
+        ranged(max_field_weight.den, den_bits)});
 #ifdef DEBUG_SEL_CIRCUIT
     print_share(max_field_weight, format("[{}] best score", index));
     print_share(max_idx[0], format("[{}] index of best score", index));
-    print_share(threshold_weight, format("[{}] T*W", index));
-    print_share(tthreshold_weight, format("[{}] Tt*W", index));
-    print_share(match, format("[{}] match?", index));
-    print_share(tmatch, format("[{}] tentative match?", index));
+    print_share(match_bits, format("[{}] match bits", index));
 #endif
 
     get_logger()->trace("Linkage circuit component {} built.", index);
 
 #ifdef DEBUG_SEL_RESULT
-    return {move(max_idx[0]), move(match), move(tmatch),
+    return {move(max_idx[0]), move(match_bits),
       move(max_field_weight.num), move(max_field_weight.den)};
 #else
-    return {move(max_idx[0]), move(match), move(tmatch)};
+    return {move(max_idx[0]), move(match_bits)};
 #endif
   }
 
+  /**
+   * Classifies the scores into the bands non-match, tentative match and match,
+   * returning their 2-bit match bits, see MatchBit and TMatchBit.
+   * Both thresholds are multiplied with the weight sums in a single SIMD
+   * multiplication. The products are converted to logic space together with
+   * the field weight sums and compared to them in a single SIMD comparator.
+   */
+  BoolShare threshold_bands(const RangedQuotient& score) {
+    const uint32_t n = score.num.get_nvals();
+    const auto thresholds_weight =
+      vcombine(vector<Ranged<MultShare>>{const_threshold(ins.const_threshold(n)),
+          const_threshold(ins.const_tthreshold(n))})
+      * vcombine(vector<Ranged<MultShare>>{score.den, score.den});
+
+    Ranged<BoolShare> b_thresholds_weight, b_sum_field_weight;
+    if constexpr (do_arith_mult) {
+      // Single conversion of both products and the field weight sums
+      auto bs = to_bool(vcombine<ArithShare>({thresholds_weight.get(),
+            score.num.get()})).split({2*n, n});
+      b_thresholds_weight = ranged(move(bs[0]), thresholds_weight.bits());
+      b_sum_field_weight = ranged(move(bs[1]), score.num.bits());
+    } else {
+      b_thresholds_weight = thresholds_weight;
+      b_sum_field_weight = score.num;
+    }
+
+    // [match, tmatch] for all scores
+    const auto bits = (b_thresholds_weight < vcombine(vector<Ranged<BoolShare>>{
+          b_sum_field_weight, b_sum_field_weight})).split(n);
+    static_assert(MatchBit == 0 && TMatchBit == 1);
+    return hcombine(bits);
+  }
+
   LinkageOutputShares to_linkage_output(const LinkageShares<MultShare>& s) {
     // Output shares should be XOR, not Yao shares
     auto index = to_gmw(s.index);
-    auto match = to_gmw(s.match);
-    auto tmatch = to_gmw(s.tmatch);
+    auto match_bits = to_gmw(s.match_bits);
 #ifdef DEBUG_SEL_RESULT
     // If result debugging is enabled, we let all parties learn all fields plus
     // the individual {field-,}weight-sums.
     // matching mode flag is ignored - it's basically always on.
-    return {out(index, ALL), out(match, ALL), out(tmatch, ALL),
+    return {out(index, ALL), out(match_bits, ALL),
           out(s.score_numerator, ALL), out(s.score_denominator, ALL)};
 #else // !DEBUG_SEL_RESULT - Normal productive mode
-    return {out_shared(index), out_shared(match), out_shared(tmatch)};
+    return {out_shared(index), out_shared(match_bits)};
 #endif // end ifdef DEBUG_SEL_RESULT
   }
 
-  CountOutputShares sum_linkage_shares(std::vector<LinkageShares<MultShare>> ls) {
+  ChunkOutputShares to_chunk_output(const typename MultQuotientFolder::Leaf& best) {
+    const auto score = best.get_selector();
+    return {out_shared(to_out_space(score.num)), out_shared(to_out_space(score.den)),
+      out_shared(to_gmw(best.get_targets()[0]))};
+  }
+
+  CountOutputShares sum_match_bits(const vector<BoolShare>& match_bits) {
     vector<BoolShare> matches, tmatches;
-    const auto n = ls.size();
-    matches.reserve(n);
-    tmatches.reserve(n);
-    for (auto& l : ls) {
-      matches.emplace_back(l.match);
-      tmatches.emplace_back(l.tmatch);
+    for (const auto& bits : match_bits) {
+      // In batched mode, the match bits of all records are SIMD values
+      auto records = bits.get_nvals() > 1 ? bits.split(1) : vector<BoolShare>{bits};
+      for (const auto& r : records) {
+        matches.emplace_back(r.bit(MatchBit));
+        tmatches.emplace_back(r.bit(TMatchBit));
+      }
     }
 
     return {out(to_gmw(sum(matches)), ALL), out(to_gmw(sum(tmatches)), ALL)};
   }
 
   /**
-   * Bit-usage of nfields many weights summed up
+   * Threshold constant, which is at most 1 in fixed-point precision dice_prec
    */
-  size_t weight_sum_bits(size_t nfields) {
-      return cfg.weight_prec + ceil_log2(nfields);
+  Ranged<MultShare> const_threshold(const MultShare& threshold) const {
+    return ranged(threshold, cfg.dice_prec + 1);
   }
 
-  auto max_quotient(const vector<QuotientShare>& quotients,
-      size_t nfields) {
-    __ignore(nfields);
-    if constexpr (do_arith_mult) {
-      return max_tie(quotients, to_bool_closure, to_arith_closure, weight_sum_bits(nfields));
-    } else {
-      return max_tie(quotients);
-    }
+  /**
+   * Prepends the best results of all previous chunks to each segment of score
+   * and returns them
+   */
+  CarryShares<MultShare> prepend_carry(RangedQuotient& score, size_t index) {
+    auto carry = ins.get_carry(index,
+        score.num.get().get_bitlen(), score.den.get().get_bitlen());
+    score.num = ranged(prepend_segments(carry.num, score.num.get()),
+        score.num.bits());
+    score.den = ranged(prepend_segments(carry.den, score.den.get()),
+        score.den.bits());
+    return carry;
   }
 
-  auto max_index(QuotientShare&& field_weights) {
-    return max_targets(forward<QuotientShare>(field_weights), {ins.const_idx()}, cfg.epi.nfields);
+  auto max_index(RangedQuotient&& field_weights, size_t index) {
+    vector<BoolShare> targets{ins.const_idx()};
+    vector<size_t> segments(ins.nsegments(), ins.dbsize());
+    if (ins.has_carry()) {
+      // The best results of all previous chunks compete as the first element
+      // of each segment.
+      const auto carry = prepend_carry(field_weights, index);
+      targets[0] = prepend_segments(carry.index, targets[0]);
+      for (auto& s : segments) ++s;
+    }
+    return max_targets(forward<RangedQuotient>(field_weights), move(targets),
+        move(segments));
   }
 
-  auto max_targets(QuotientShare&& quotients, vector<BoolShare>&& targets, size_t nfields) {
-    __ignore(nfields);
-    MultQuotientFolder folder(forward<QuotientShare>(quotients),
-        MultQuotientFolder::FoldOp::MAX_TIE, forward<vector<BoolShare>>(targets));
+  auto max_targets(RangedQuotient&& quotients, vector<BoolShare>&& targets,
+      vector<size_t>&& segments, size_t block_size = 1) {
+    const QuotientBitWidths widths{quotients.num.bits(), quotients.den.bits(),
+      cfg.bitlen};
+    MultQuotientFolder folder(
+        QuotientShare{quotients.num.get(), quotients.den.get()},
+        MultQuotientFolder::FoldOp::MAX_TIE, forward<vector<BoolShare>>(targets),
+        forward<vector<size_t>>(segments), block_size);
     if constexpr (do_arith_mult) {
-      folder.set_converters_and_den_bits(&to_bool_closure, &to_arith_closure,
-          weight_sum_bits(nfields));
+      folder.set_converters_and_den_bits(&to_bool_closure, &to_arith_closure);
     }
+    folder.set_bit_widths(widths);
     return folder.fold();
   }
 
-  FieldWeight<MultShare> best_group_weight(size_t index, const IndexSet& group_set) {
-    vector<FieldName> group{begin(group_set), end(group_set)};
-    // copy group to store permutations
-    vector<FieldName> groupPerm = group;
-    size_t size = group.size();
-
-    vector<QuotientShare> perm_weights; // where we store all weights before max
-    perm_weights.reserve(factorial<size_t>(size));
-    // iterate over all group permutations and calc field-weight
-    do {
-      vector<FieldWeight<MultShare>> field_weights;
-      field_weights.reserve(size);
-      for (size_t i = 0; i != size; ++i) {
-        const auto& ileft = group[i];
-        const auto& iright = groupPerm[i];
-        field_weights.emplace_back(field_weight({index, ileft, iright}));
+  /*
+   * Evaluates all permutations of an exchange group in parallel: for each
+   * position of the group, the field weights of all permutations are
+   * vertically combined into a single share of nperms*nvals values, so that
+   * the permutation sums take size-1 SIMD additions and the max-fold takes
+   * ceil(log2(nperms)) SIMD selections, instead of gates per permutation.
+   */
+  FieldWeight<MultShare> best_group_weight(size_t index,
+      const LinkagePlan::ExchangeGroup& group) {
+    const size_t size = group.fields.size();
+    const size_t nperms = group.permutations.size();
+
+    // Position i of the group, for all permutations
+    vector<FieldWeight<MultShare>> field_weights;
+    field_weights.reserve(size);
+    for (size_t i = 0; i != size; ++i) {
+      vector<Ranged<MultShare>> fws, ws;
+      fws.reserve(nperms);
+      ws.reserve(nperms);
+      for (const auto& perm : group.permutations) {
+        const auto& fweight = field_weight(index, perm[i]);
+        fws.emplace_back(fweight.fw);
+        ws.emplace_back(fweight.w);
       }
-      // sum all field-weights for this permutation
-      QuotientShare sum_perm_weight = sum(field_weights);
+      field_weights.push_back({vcombine(fws), vcombine(ws)});
+    }
+    // sum all field-weights of all permutations at once
+    RangedQuotient perm_weights = sum(field_weights);
 #ifdef DEBUG_SEL_CIRCUIT
-      print_share(sum_perm_weight,
-                  format("[{}] sum_perm_weight ({}|{})", index, group, groupPerm));
+    print_share(perm_weights.num.get(),
+        format("[{}] sum_perm_weights ({}, {} permutations, num)", index,
+          group.fields, nperms));
+    print_share(perm_weights.den.get(),
+        format("[{}] sum_perm_weights ({}, {} permutations, den)", index,
+          group.fields, nperms));
 #endif
-      // collect for later max
-      perm_weights.emplace_back(sum_perm_weight);
-    } while (next_permutation(groupPerm.begin(), groupPerm.end()));
 
-    auto max_perm_weight = max_quotient(perm_weights, weight_sum_bits(size));
+    // The best permutation's weights have the same widths as all of them
+    const size_t num_bits = perm_weights.num.bits();
+    const size_t den_bits = perm_weights.den.bits();
+    const size_t block_size = perm_weights.num.get_nvals() / nperms;
+    auto max_perm_weight = max_targets(move(perm_weights), {}, {nperms},
+        block_size).get_selector();
 #ifdef DEBUG_SEL_CIRCUIT
     print_share(max_perm_weight,
-                format("[{}] max_perm_weight ({})", index, group));
+                format("[{}] max_perm_weight ({})", index, group.fields));
 #endif
     // Treat quotient as FieldWeight
-    return {move(max_perm_weight.num), move(max_perm_weight.den)};
+    return {ranged(move(max_perm_weight.num), num_bits),
+      ranged(move(max_perm_weight.den), den_bits)};
   }
 
   /**
-   * Cache to store calls to field_weight()
+   * Cache to store calls to field_weight(), by flat_index()
    * Can save half the circuit in permutation groups this way.
    */
-  std::map<ComparisonIndex, FieldWeight<MultShare>> field_weight_cache;
+  vector<FieldWeight<MultShare>> field_weight_cache;
+
+  /**
+   * Index into the comparison caches of plan comparison c of record share index
+   */
+  size_t flat_index(size_t index, size_t c) const {
+    return index * plan.comparisons.size() + c;
+  }
+
+  ComparisonIndex comparison_index(size_t index, size_t c) const {
+    const auto& comparison = plan.comparisons[c];
+    return {index, comparison.left, comparison.right};
+  }
+
+  /**
+   * Sizes the comparison caches for the current input and batch-converts all
+   * comparisons if needed
+   */
+  void prepare_build() {
+    const size_t ncomparisons = ins.nrecord_shares() * plan.comparisons.size();
+    field_weight_cache.resize(ncomparisons);
+    comparison_cache.resize(ncomparisons);
+    if constexpr (do_arith_mult) convert_comparisons();
+  }
 
   /**
    * Calculates the field weight and addend to the total weight.
@@ -366,18 +597,26 @@ private:
    * - Multiply result of comparison with weight -> field weight
    * - Return field weight and weight
    */
-  const FieldWeight<MultShare>& field_weight(const ComparisonIndex& i) {
+  const FieldWeight<MultShare>& field_weight(size_t index, size_t c) {
+    const auto i = comparison_index(index, c);
     // Probe cache
-    const auto& cache_hit = field_weight_cache.find(i);
-    if (cache_hit != field_weight_cache.cend()) {
+    auto& cached = field_weight_cache[flat_index(index, c)];
+    if (!cached.w.is_null()) {
       get_logger()->trace("field_weight cache hit for {}", i);
-      return cache_hit->second;
+      return cached;
     }
 
     const auto delta_weight = weight(i);
-    const auto comp = compare(i);
-
-    MultShare field_weight = delta_weight * comp;
+    Ranged<MultShare> field_weight;
+    if constexpr (!do_arith_mult) {
+      if (!is_dice(i)) {
+        // The equality bit only selects the weight, which is then shifted by
+        // dice_prec, instead of multiplying it with the shifted bit.
+        field_weight = (delta_weight * ranged(equality(i), 1))
+          .shifted_left(cfg.dice_prec);
+      }
+    }
+    if (field_weight.is_null()) field_weight = delta_weight * compare(index, c);
 
 #ifdef DEBUG_SEL_CIRCUIT
     //FIXME(SS): Compilation error, if -DDEBUG_SEL_CIRCUIT
@@ -386,30 +625,100 @@ private:
     //print_share(field_weight, format("^^^^ field weight ({}){} ^^^^", ftype, i));
 #endif
 
-    return field_weight_cache[i] = {field_weight, delta_weight};
+    return cached = {field_weight, delta_weight};
   }
 
-  MultShare weight(const ComparisonIndex& i) {
-    return delta(i) * ins.get_const_weight(i); // Arith: free constant multiplication
+  /**
+   * Rescaled weight, which fits into weight_prec bits, or 0 if any field is
+   * empty. Boolean: a single bit selects the weight, no multiplication.
+   */
+  Ranged<MultShare> weight(const ComparisonIndex& i) {
+    // Arith: free constant multiplication
+    return delta(i) * ranged(ins.get_const_weight(i), cfg.weight_prec);
   }
 
-  MultShare delta(const ComparisonIndex& i) {
+  Ranged<MultShare> delta(const ComparisonIndex& i) {
     const auto [client_entry, server_entry] = ins.get(i);
     if constexpr (do_arith_mult) {
-      return client_entry.delta * server_entry.delta;
+      return ranged<ArithShare>(client_entry.delta * server_entry.delta, 1);
     } else {
-      return client_entry.delta & server_entry.delta;
+      return ranged(client_entry.delta & server_entry.delta, 1);
     }
   }
 
   /**
-   * compare returns the comparison of the fields specified by i
-   * It handles the logic of choosing the right comparison method depending on
-   * the field comparator type
+   * Comparison results in arithmetic space, filled by convert_comparisons(),
+   * by flat_index()
+   */
+  vector<MultShare> comparison_cache;
+
+  /**
+   * Converts the boolean comparison results of all record shares into
+   * arithmetic space in batches: All results of the same bitlength are
+   * combined into a single SIMD share, converted by a single conversion gate
+   * and split again. This saves many conversion gates and OT batches compared
+   * to converting each comparison separately.
    */
-  MultShare compare(const ComparisonIndex& i) {
-    const auto ftype = cfg.epi.fields.at(i.left).comparator;
-    return (ftype == FieldComparator::DICE) ?  dice_coefficient(i) : equality(i);
+  void convert_comparisons() {
+    struct Batch {
+      vector<size_t> flat_indices;
+      vector<BoolShare> comps;
+    };
+    map<uint32_t, Batch> batches; // by bitlen, i.e., dice and equality
+    for (size_t index = 0; index != ins.nrecord_shares(); ++index) {
+      for (size_t c = 0; c != plan.comparisons.size(); ++c) {
+        auto comp = bool_compare(comparison_index(index, c));
+        auto& batch = batches[comp.get_bitlen()];
+        batch.comps.emplace_back(move(comp));
+        batch.flat_indices.emplace_back(flat_index(index, c));
+      }
+    }
+
+    for (const auto& [bitlen, batch] : batches) {
+      get_logger()->debug("Converting {} comparisons of bitlength {} at once.",
+          batch.comps.size(), bitlen);
+      const auto nvals = transform_vec(batch.comps,
+          [](const BoolShare& s) { return s.get_nvals(); });
+      auto converted = to_arith(vcombine(batch.comps)).split(nvals);
+      for (size_t k = 0; k != converted.size(); ++k) {
+        comparison_cache[batch.flat_indices[k]] = move(converted[k]);
+      }
+    }
+  }
+
+  /**
+   * compare returns plan comparison c of record share index in
+   * multiplication space, fixed-point with precision dice_prec.
+   * For arithmetic multiplication, it uses the batch-converted result if
+   * available.
+   */
+  Ranged<MultShare> compare(size_t index, size_t c) {
+    const auto i = comparison_index(index, c);
+    // Both dice coefficients and shifted equality bits are at most 2^dice_prec
+    const size_t bits = cfg.dice_prec + 1;
+    if constexpr (do_arith_mult) {
+      const auto& cached = comparison_cache[flat_index(index, c)];
+      const ArithShare comp = cached.is_null() ? to_arith(bool_compare(i)) : cached;
+      // Equality bits were converted as single bits. A multiplication with the
+      // constant 2^dice_prec is free.
+      return ranged<ArithShare>(
+          is_dice(i) ? comp : ArithShare{comp * ins.const_dice_prec_factor()}, bits);
+    } else {
+      return is_dice(i) ? ranged(dice_coefficient(i), bits) :
+        ranged(equality(i), 1).shifted_left(cfg.dice_prec);
+    }
+  }
+
+  bool is_dice(const ComparisonIndex& i) const {
+    return cfg.epi.field_specs[i.left].comparator == FieldComparator::DICE;
+  }
+
+  /**
+   * Boolean comparison of the fields specified by i, depending on the field
+   * comparator type
+   */
+  BoolShare bool_compare(const ComparisonIndex& i) {
+    return is_dice(i) ? dice_coefficient(i) : equality(i);
   }
 
   /**
@@ -419,7 +728,7 @@ private:
   * always rounds down, which would lead to a bias.
   * Output is a fixed-point number with precision cfg.dice_prec
   */
-  MultShare dice_coefficient(const ComparisonIndex& i) {
+  BoolShare dice_coefficient(const ComparisonIndex& i) {
     const auto [client_entry, server_entry] = ins.get(i);
 
     const BoolShare hw_plus = client_entry.hw + server_entry.hw; // denominator
@@ -428,10 +737,11 @@ private:
     // fixed point rounding integer division
     // hw_size(bitsize) + 1 because we multiply numerator with 2 and denominator is sum
     // of two values of original bitsize. Both are hammingweights.
-    const auto bitsize = hw_size(cfg.epi.fields.at(i.left).bitsize) + 1;
-    const auto int_div_file_path = format((cfg.circ_dir/"sel_int_div/{}_{}.aby").string(),
-        bitsize, cfg.dice_prec);
-    const BoolShare dice = apply_file_binary(hw_and_twice, hw_plus, bitsize, bitsize, int_div_file_path);
+    const auto bitsize = hw_size(cfg.epi.field_specs[i.left].bitsize) + 1;
+    const auto int_div_file = int_div_files.find(bitsize);
+    const BoolShare dice = (int_div_file != int_div_files.cend()) ?
+      apply_file_binary(hw_and_twice, hw_plus, bitsize, bitsize, int_div_file->second) :
+      int_div(hw_and_twice, hw_plus, bitsize, cfg.dice_prec, int_div_opt);
 
 #ifdef DEBUG_SEL_CIRCUIT
     print_share(hw_and_twice, format("hw_and_twice {}", i));
@@ -439,27 +749,24 @@ private:
     print_share(dice, format("dice {}", i));
 #endif
 
-    return to_mult_space(dice);
+    return dice;
   }
 
   /**
-  * Binary-compares two shares
+  * Binary-compares two shares.
+  * The single bit is only shifted to the left by dice_prec later on: for
+  * arithmetic multiplication, it is cheaper to first do a single-bit
+  * conversion into an arithmetic share and then a free multiplication with a
+  * constant 2^dice_prec. For boolean multiplication, the bit selects the
+  * weight, see field_weight().
   */
-  MultShare equality(const ComparisonIndex& i) {
+  BoolShare equality(const ComparisonIndex& i) {
     const auto [client_entry, server_entry] = ins.get(i);
     const BoolShare cmp = (client_entry.val == server_entry.val);
 #ifdef DEBUG_SEL_CIRCUIT
     print_share(cmp, format("equality {}", i));
 #endif
-    if constexpr (do_arith_mult) {
-    // For arithmetic multiplication:
-    // Instead of left-shifting the bool share, it is cheaper to first do a
-    // single-bit conversion into an arithmetic share and then a free
-    // multiplication with a constant 2^dice_prec
-      return to_mult_space(cmp) * ins.const_dice_prec_factor();
-    } else {
-      return to_mult_space(cmp << cfg.dice_prec);
-    }
+    return cmp;
   }
 
 };
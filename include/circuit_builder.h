@@ -27,8 +27,12 @@ class ArithmeticCircuit;
 
 namespace sel {
 
+// Bits of the 2-bit match classification of a score. A match always is a
+// tentative match too, so the bands are 0: non-match, 2: tentative, 3: match.
+constexpr uint32_t MatchBit = 0, TMatchBit = 1;
+
 struct LinkageOutputShares {
-  OutShare index, match, tmatch;
+  OutShare index, match_bits; // see MatchBit, TMatchBit
 #ifdef DEBUG_SEL_RESULT
   OutShare score_numerator, score_denominator;
 #endif
@@ -38,6 +42,13 @@ struct CountOutputShares {
   OutShare matches, tmatches;
 };
 
+/**
+ * Shared outputs of an intermediate chunk, to be carried to the next chunk
+ */
+struct ChunkOutputShares {
+  OutShare num, den, index;
+};
+
 class CircuitBuilderBase {
 public:
   virtual ~CircuitBuilderBase() = default;
@@ -49,8 +60,19 @@ public:
       const EpilinkServerInput& in_server) = 0;
 #endif
 
+  /**
+   * Sets the database chunk of the next circuit. Must be called before
+   * set_input().
+   */
+  virtual void set_chunk(ChunkInfo&& chunk) = 0;
+
   virtual std::vector<LinkageOutputShares> build_linkage_circuit() = 0;
   virtual CountOutputShares build_count_circuit() = 0;
+  /**
+   * Builds the circuit of an intermediate chunk, only outputting the shared
+   * best scores and indices
+   */
+  virtual std::vector<ChunkOutputShares> build_chunk_circuit() = 0;
 
   virtual void reset() = 0;
 };
@@ -38,6 +38,13 @@ size_t bit_usage(const size_t dice_prec,
   return dice_prec + 2*weight_prec + ceil_log2(nfields*nfields);
 }
 
+// Precisions below this are too coarse to be useful, even for binary fields
+constexpr size_t MinPrecision = 4;
+
+bool is_word_size(size_t bitlen) {
+  return find(WordSizes.cbegin(), WordSizes.cend(), bitlen) != WordSizes.cend();
+}
+
 CircuitConfig::CircuitConfig(const EpilinkConfig& epi_,
     const std::filesystem::path& circ_dir_,
     const bool matching_mode, const BooleanSharing bool_sharing_,
@@ -85,6 +92,11 @@ void CircuitConfig::set_precisions(size_t dice_prec_, size_t weight_prec_) {
 }
 
 void CircuitConfig::set_ideal_precision() {
+  if (!bitlen) {
+    bitlen = min_word_size();
+    get_logger()->debug("Selected circuit word size {}", bitlen);
+  }
+
   size_t bits_av = bitlen - ceil_log2(epi.nfields*epi.nfields);
   size_t dice_prec = (bits_av)/3;
   size_t weight_prec = dice_prec;
@@ -109,12 +121,12 @@ unsigned long long rescale_weight(Weight weight, size_t prec, Weight max_weight)
   return llround((weight/max_weight) * max_el);
 }
 
-CircUnit CircuitConfig::rescaled_weight(const FieldName& name) const {
-  return rescale_weight(epi.fields.at(name).weight, weight_prec, epi.max_weight);
+CircUnit CircuitConfig::rescaled_weight(FieldId id) const {
+  return rescale_weight(epi.field_specs[id].weight, weight_prec, epi.max_weight);
 }
 
-CircUnit CircuitConfig::rescaled_weight(const FieldName& name1, const FieldName& name2) const {
-  const auto weight = (epi.fields.at(name1).weight + epi.fields.at(name2).weight)/2.0;
+CircUnit CircuitConfig::rescaled_weight(FieldId id1, FieldId id2) const {
+  const auto weight = (epi.field_specs[id1].weight + epi.field_specs[id2].weight)/2.0;
   return rescale_weight(weight, weight_prec, epi.max_weight);
 }
 
@@ -133,6 +145,33 @@ vector<CircUnit> rescale_weights(const vector<Weight>& weights,
   return ret;
 }
 
+pair<size_t, size_t> CircuitConfig::min_precisions() const {
+  size_t dice_prec = MinPrecision, weight_prec = MinPrecision;
+  for (const auto& f : epi.field_specs) {
+    if (f.comparator == FieldComparator::DICE) {
+      // resolve hamming weights of full bitmasks, and one bit for the factor 2
+      dice_prec = max(dice_prec, hw_size(f.bitsize) + 1);
+    }
+    if (f.weight > 0) {
+      // smallest weight must not get rescaled to 0
+      const auto ratio = static_cast<size_t>(ceil(epi.max_weight / f.weight));
+      weight_prec = max(weight_prec, static_cast<size_t>(ceil_log2(ratio)) + 1);
+    }
+  }
+  return {dice_prec, weight_prec};
+}
+
+size_t CircuitConfig::min_word_size() const {
+  const auto [dice_prec, weight_prec] = min_precisions();
+  const auto usage = bit_usage(dice_prec, weight_prec, epi.nfields);
+  for (const auto word_size : WordSizes) {
+    if (usage <= word_size) return word_size;
+  }
+  throw invalid_argument(fmt::format("Minimum dice and weight precisions {} "
+        "and {} need {} bits, more than the largest word size {}.",
+        dice_prec, weight_prec, usage, WordSizes.back()));
+}
+
 size_t hw_size(size_t size) {
   return ceil_log2_min1(size+1);
 }
@@ -22,12 +22,17 @@
 
 #include "epilink_input.h"
 #include <filesystem>
+#include <array>
 
 namespace sel {
 
-using CircUnit = uint32_t;
+// Clear values of circuit in- and outputs, wide enough for all word sizes
+using CircUnit = uint64_t;
 using VCircUnit = std::vector<CircUnit>;
-constexpr size_t BitLen = sizeof(CircUnit)*8;
+// Default circuit word size
+constexpr size_t BitLen = 32;
+// Supported circuit word sizes, i.e., bitlens of arithmetic shares
+constexpr std::array<size_t, 3> WordSizes{16, 32, 64};
 
 enum class BooleanSharing { GMW = 0, YAO = 1 };
 
@@ -40,7 +45,27 @@ struct CircuitConfig {
   bool matching_mode = false;
   BooleanSharing bool_sharing = BooleanSharing::YAO;
   bool use_conversion = true;
+  // Circuit word size, one of WordSizes. Passing 0 to the constructor selects
+  // the smallest word size that fits the configured fields.
   size_t bitlen = BitLen;
+  // Evaluate all client records in a single SIMD circuit instead of
+  // instantiating one sub-circuit per record.
+  bool batch_records = false;
+  // Maximum number of database records per circuit. Larger databases are
+  // linked in consecutive circuits, carrying the best results of all previous
+  // chunks as shares. 0 disables chunking.
+  size_t chunk_size = 0;
+  // Only consider permutations of exchange groups that move at most this many
+  // fields away from their own position, instead of all size! permutations.
+  // Bounds the circuit size for large groups, e.g., 2 only considers single
+  // swaps. Those still compare every pair of group fields, i.e., need all
+  // size^2 comparisons, only the sums and selections of the permutations
+  // shrink. 0 considers all permutations, as in the original EpiLink algorithm.
+  size_t max_exchanged_fields = 0;
+  // Read the integer division circuits of dice coefficients from the
+  // precomputed files in circ_dir/sel_int_div instead of generating them. The
+  // generated circuits are smaller in Yao and shallower in GMW.
+  bool use_int_div_files = false;
 
   // pre-calculated fields
   size_t dice_prec, weight_prec;
@@ -62,16 +87,35 @@ struct CircuitConfig {
   /**
   * Set ideal precisions, equally distributing available bits to weight and
   * dice precision such that 2*wp + dp = bitlen - ceil_log2(n*n).
-  * TODO: As of now, this cannot be used with the ABY circuit yet because we
-  * use a fixed 16-bit integer division. The constructor sets the precisions
-  * accordingly.
+  * If no bitlen is set (0), the smallest word size is selected in which the
+  * minimum precisions of the configured fields fit, see min_precisions().
+  * Integer division circuits are generated on the fly for any dice precision,
+  * see aby/int_div.h.
   */
   void set_ideal_precision();
 
-  CircUnit rescaled_weight(const FieldName&) const;
-  CircUnit rescaled_weight(const FieldName&, const FieldName&) const;
+  CircUnit rescaled_weight(FieldId) const;
+  CircUnit rescaled_weight(FieldId, FieldId) const;
+
+  /**
+   * Minimum dice and weight precisions, which still resolve the dice
+   * coefficients of the largest bitmask field and the smallest weight relative
+   * to the largest one.
+   */
+  std::pair<size_t, size_t> min_precisions() const;
+
+  /**
+   * Smallest of the WordSizes in which the minimum precisions fit. Throws
+   * invalid_argument if they don't even fit into the largest one.
+   */
+  size_t min_word_size() const;
 };
 
+/**
+ * Whether ABY circuits can be built with the given word size
+ */
+bool is_word_size(size_t bitlen);
+
 /**
  * bits required to store hammingweight of bitmask of given size
  */
@@ -89,7 +133,7 @@ struct formatter<sel::BooleanSharing> {
 
   template <typename FormatContext>
   auto format(const sel::BooleanSharing& bs, FormatContext &ctx) {
-    return format_to(ctx.begin(), bs == sel::BooleanSharing::GMW ? "GMW" : "YAO");
+    return format_to(ctx.out(), bs == sel::BooleanSharing::GMW ? "GMW" : "YAO");
   }
 };
 
@@ -100,16 +144,19 @@ struct formatter<sel::CircuitConfig> {
 
   template <typename FormatContext>
   auto format(const sel::CircuitConfig& conf, FormatContext &ctx) {
-    auto out =  format_to(ctx.begin(),
+    auto out =  format_to(ctx.out(),
         "CircuitConfig{{{}, mathing_mode={}, bitlen={}, "
-        "bool_sharing={}, use_conversion={}, "
+        "bool_sharing={}, use_conversion={}, batch_records={}, "
+        "chunk_size={}, max_exchanged_fields={}, use_int_div_files={}, "
         "precisions{{dice={}, weight={}}}, rescaled_weights={{",
         conf.epi, conf.matching_mode, conf.bitlen,
-        conf.bool_sharing, conf.use_conversion,
+        conf.bool_sharing, conf.use_conversion, conf.batch_records,
+        conf.chunk_size, conf.max_exchanged_fields, conf.use_int_div_files,
         conf.dice_prec, conf.weight_prec
     );
-    for (const auto& f : conf.epi.fields) {
-      out = format_to(out, "{}: {:x}, ", f.first, conf.rescaled_weight(f.first));
+    for (sel::FieldId i = 0; i != conf.epi.nfields; ++i) {
+      out = format_to(out, "{}: {:x}, ", conf.epi.field_specs[i].name,
+          conf.rescaled_weight(i));
     }
     return format_to(out, "}}}}");
   }
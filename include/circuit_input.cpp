@@ -21,6 +21,7 @@ using fmt::format;
 #include "circuit_input.h"
 #include "aby/gadgets.h"
 #include "util.h"
+#include "math.h"
 #include "logger.h"
 
 using namespace std;
@@ -30,12 +31,6 @@ namespace sel {
 constexpr auto BIN = FieldComparator::BINARY;
 constexpr auto BM = FieldComparator::DICE;
 
-bool operator<(const ComparisonIndex& l, const ComparisonIndex& r) {
-  return l.left_idx < r.left_idx
-    || (l.left_idx == r.left_idx && l.left < r.left)
-    || (l.left_idx == r.left_idx && l.left == r.left && l.right < r.right);
-}
-
 template <class CircT>
 constexpr CircT* typed_circ(BooleanCircuit* bcirc, ArithmeticCircuit* acirc) {
   if constexpr (is_same_v<CircT, BooleanCircuit>) {
@@ -56,6 +51,7 @@ CircuitInput<MultShare>::CircuitInput(const CircuitConfig& cfg,
 template <class MultShare>
 void CircuitInput<MultShare>::set(const EpilinkClientInput& input) {
   assert(!input_set && "Input already set. Call clear() first if resetting.");
+  role = CLIENT;
   set_constants(input.database_size, input.num_records);
   set_real_client_input(input);
   set_dummy_server_input();
@@ -66,6 +62,7 @@ void CircuitInput<MultShare>::set(const EpilinkClientInput& input) {
 template <class MultShare>
 void CircuitInput<MultShare>::set(const EpilinkServerInput& input) {
   assert(!input_set && "Input already set. Call clear() first if resetting.");
+  role = SERVER;
   set_constants(input.database_size, input.num_records);
   set_dummy_client_input();
   set_real_server_input(input);
@@ -80,6 +77,9 @@ void CircuitInput<MultShare>::set_both(const EpilinkClientInput& in_client,
   assert(!input_set && "Input already set. Call clear() first if resetting.");
   assert(in_client.database_size == in_server.database_size && "Database sizes don't match!");
   assert(in_client.num_records == in_server.num_records && "Number of records don't match!");
+  if (has_carry()) {
+    throw runtime_error("Chunk carries cannot be used when setting both inputs.");
+  }
 
   set_constants(in_client.database_size, in_client.num_records);
   set_real_client_input(in_client);
@@ -96,46 +96,122 @@ void CircuitInput<MultShare>::clear() {
   weight_cache.clear();
   dbsize_ = 0;
   nrecords_ = 0;
+  chunk_ = {};
+  role = ALL;
   input_set = false;
 }
 
+template <class MultShare>
+void CircuitInput<MultShare>::set_chunk(ChunkInfo&& chunk) {
+  assert(!input_set && "Chunk must be set before the input.");
+  chunk_ = move(chunk);
+}
+
+template <class MultShare>
+CarryShares<MultShare> CircuitInput<MultShare>::get_carry(size_t index,
+    size_t num_bits, size_t den_bits) const {
+  assert(has_carry() && chunk_.carry.size() == nrecords_);
+  // In batched mode, the single record share covers all records
+  const size_t begin = cfg.batch_records ? 0 : index;
+  vector<CircUnit> nums, dens, idxs;
+  nums.reserve(nsegments());
+  dens.reserve(nsegments());
+  idxs.reserve(nsegments());
+  for (size_t j = begin; j != begin + nsegments(); ++j) {
+    const auto& c = chunk_.carry[j];
+    nums.emplace_back(c.num);
+    dens.emplace_back(c.den);
+    idxs.emplace_back(c.index);
+  }
+
+  CarryShares<MultShare> carry{
+    reshare<MultShare>(mcirc, nums, num_bits),
+    reshare<MultShare>(mcirc, dens, den_bits),
+    reshare<BoolShare>(bcirc, idxs, const_idx_.get_bitlen())
+  };
+#ifdef DEBUG_SEL_CIRCUIT
+  print_share(carry.num, format("[{}] carry num", index));
+  print_share(carry.den, format("[{}] carry den", index));
+  print_share(carry.index, format("[{}] carry index", index));
+#endif
+  return carry;
+}
+
+/**
+ * Both parties input their shares of the given values, which are then
+ * recombined inside the circuit.
+ */
+template <class MultShare>
+template <class ShareT, class CircT>
+ShareT CircuitInput<MultShare>::reshare(CircT* circ,
+    vector<CircUnit> vals, size_t bitlen) const {
+  const uint32_t n = vals.size();
+  ShareT server_part = (role == SERVER) ?
+    ShareT(circ, vals.data(), bitlen, SERVER, n) :
+    ShareT(circ, bitlen, n);
+  ShareT client_part = (role == CLIENT) ?
+    ShareT(circ, vals.data(), bitlen, CLIENT, n) :
+    ShareT(circ, bitlen, n);
+  if constexpr (is_same_v<ShareT, ArithShare>) {
+    return server_part + client_part;
+  } else {
+    return server_part ^ client_part;
+  }
+}
+
 template <class MultShare>
 ComparisonShares<MultShare> CircuitInput<MultShare>::get(const ComparisonIndex& i) const {
-  return {left_shares.at(i.left)[i.left_idx], right_shares.at(i.right)};
+  return {left_shares[i.left][i.left_idx], right_shares[i.right]};
 }
 
 template <class MultShare>
 const MultShare& CircuitInput<MultShare>::get_const_weight(const ComparisonIndex& i) const {
-  FieldNamePair ipair{i.left, i.right};
-  const auto& cache_hit = weight_cache.find(ipair);
-  if (cache_hit != weight_cache.cend()) {
+  auto& weight = weight_cache[i.left * cfg.epi.nfields + i.right];
+  if (!weight.is_null()) {
     get_logger()->trace("weight cache hit for ({}|{})", i.left, i.right);
-    return cache_hit->second;
+    return weight;
   }
 
   const CircUnit weight_r = cfg.rescaled_weight(i.left, i.right);
-  MultShare weight = constant_simd(mcirc, weight_r, BitLen, dbsize_);
+  return weight =
+    constant_simd(mcirc, weight_r, const_bitlen(cfg.weight_prec), nvals());
+}
+
+template <class MultShare>
+MultShare CircuitInput<MultShare>::const_threshold(size_t nvals) const {
+  return constant_simd(mcirc, threshold_, const_bitlen(cfg.dice_prec + 1), nvals);
+}
 
-  return weight_cache[ipair] = weight;
+template <class MultShare>
+MultShare CircuitInput<MultShare>::const_tthreshold(size_t nvals) const {
+  return constant_simd(mcirc, tthreshold_, const_bitlen(cfg.dice_prec + 1), nvals);
 }
 
 template <class MultShare>
 void CircuitInput<MultShare>::set_constants(size_t database_size, size_t num_records) {
   dbsize_ = database_size;
   nrecords_ = num_records;
-  const_idx_ = ascending_numbers_constant(bcirc, dbsize_);
+  weight_cache.resize(cfg.epi.nfields * cfg.epi.nfields);
+  // In chunked mode, indices are global and need a fixed bitlen across chunks
+  const size_t idx_bits = chunk_.total_database_size ?
+    ceil_log2_min1(chunk_.total_database_size) : 0;
+  const_idx_ = ascending_numbers_constant(bcirc, dbsize_, chunk_.offset, idx_bits);
+  if (nsegments() > 1) {
+    const_idx_ = vcombine<BoolShare>(vector<BoolShare>(nsegments(), const_idx_));
+  }
 
   const_dice_prec_factor_ =
-    constant_simd(mcirc, (1 << cfg.dice_prec), BitLen, database_size);
+    constant_simd(mcirc, (1ULL << cfg.dice_prec), cfg.bitlen, nvals());
 
-  CircUnit T = llround(cfg.epi.threshold * (1 << cfg.dice_prec));
-  CircUnit Tt = llround(cfg.epi.tthreshold * (1 << cfg.dice_prec));
+  threshold_ = llround(cfg.epi.threshold * (1ULL << cfg.dice_prec));
+  tthreshold_ = llround(cfg.epi.tthreshold * (1ULL << cfg.dice_prec));
 
   get_logger()->debug(
-      "Rescaled threshold: {:x}/ tentative: {:x}", T, Tt);
+      "Rescaled threshold: {:x}/ tentative: {:x}", threshold_, tthreshold_);
 
-  const_threshold_ = constant(mcirc, T, BitLen);
-  const_tthreshold_ = constant(mcirc, Tt, BitLen);
+  // Thresholds are compared against the folded scores, one per segment
+  const_threshold_ = const_threshold(nsegments());
+  const_tthreshold_ = const_tthreshold(nsegments());
 #ifdef DEBUG_SEL_CIRCUIT
   print_share(const_idx_, "const_idx");
   print_share(const_dice_prec_factor_, "const_dice_prec_factor");
@@ -146,72 +222,88 @@ void CircuitInput<MultShare>::set_constants(size_t database_size, size_t num_rec
 
 template <class MultShare>
 void CircuitInput<MultShare>::set_real_client_input(const EpilinkClientInput& input) {
-  for (const auto& _f : cfg.epi.fields) {
-    const FieldName& i = _f.first;
+  left_shares.resize(cfg.epi.nfields);
+  for (FieldId i = 0; i != cfg.epi.nfields; ++i) {
     left_shares[i] = make_client_entry_shares(input, i);
   }
 }
 
 template <class MultShare>
 void CircuitInput<MultShare>::set_real_server_input(const EpilinkServerInput& input) {
-  for (const auto& _f : cfg.epi.fields) {
-    const FieldName& i = _f.first;
+  right_shares.resize(cfg.epi.nfields);
+  for (FieldId i = 0; i != cfg.epi.nfields; ++i) {
     right_shares[i] = make_server_entries_share(input, i);
   }
 }
 
 template <class MultShare>
 void CircuitInput<MultShare>::set_dummy_client_input() {
-  for (const auto& _f : cfg.epi.fields) {
-    const FieldName& i = _f.first;
+  left_shares.resize(cfg.epi.nfields);
+  for (FieldId i = 0; i != cfg.epi.nfields; ++i) {
     auto& entries = left_shares[i];
-    entries.reserve(nrecords_);
-    for (size_t j = 0; j != nrecords_; ++j) {
-      entries.emplace_back(make_dummy_entry_share(i));
+    entries.reserve(nrecord_shares());
+    for (size_t j = 0; j != nrecord_shares(); ++j) {
+      entries.emplace_back(broadcast(make_dummy_entry_share(i, nsegments())));
     }
   }
 }
 
 template <class MultShare>
 void CircuitInput<MultShare>::set_dummy_server_input() {
-  for (const auto& _f : cfg.epi.fields) {
-    const FieldName& i = _f.first;
-    right_shares[i] = make_dummy_entry_share(i);
+  right_shares.resize(cfg.epi.nfields);
+  for (FieldId i = 0; i != cfg.epi.nfields; ++i) {
+    right_shares[i] = make_dummy_entry_share(i, nvals());
   }
 }
 
 template <class MultShare>
 EntryShare<MultShare> CircuitInput<MultShare>::make_server_entries_share(const EpilinkServerInput& input,
-    const FieldName& i) {
-  const auto& f = cfg.epi.fields.at(i);
-  const VFieldEntry& entries = input.database->at(i);
-  size_t bytesize = bitbytes(f.bitsize);
-  Bitmask dummy_bm(bytesize);
-  VBitmask values = transform_vec(entries,
-      [&dummy_bm](auto e){return e.value_or(dummy_bm);});
-  check_vectors_size(values, bytesize, "server input byte vector "s + i);
-
-  // value
-  BoolShare val(bcirc,
-      concat_vec(values).data(), f.bitsize, SERVER, dbsize_);
+    FieldId i) {
+  const auto& f = cfg.epi.field_specs[i];
+  const FieldColumn& column = input.database->at(f.name);
+  if (column.bitsize() != f.bitsize) {
+    throw invalid_argument(fmt::format("Server input column {} has bitsize {}, "
+          "expected {}.", f.name, column.bitsize(), f.bitsize));
+  }
 
-  // delta
-  vector<CircUnit> db_delta(dbsize_);
-  for (size_t j=0; j!=dbsize_; ++j) db_delta[j] = entries[j].has_value();
-  MultShare delta(mcirc, db_delta.data(), delta_bitlen, SERVER, dbsize_);
+  // The column's buffers already have ABY's SIMD input layout. ABY only reads
+  // from the input buffers.
+  BoolShare val(bcirc, const_cast<uint8_t*>(column.data()), f.bitsize,
+      SERVER, dbsize_);
+
+  // delta, from the prepared database if the server has one
+  static_assert(is_same_v<CircUnit, uint64_t>,
+      "PreparedDatabase deltas must be circuit words");
+  vector<CircUnit> db_delta;
+  CircUnit* delta_data;
+  if (input.prepared) {
+    delta_data = const_cast<CircUnit*>(input.prepared->deltas.at(f.name).data())
+      + input.prepared_offset;
+  } else {
+    db_delta.resize(dbsize_);
+    for (size_t j=0; j!=dbsize_; ++j) db_delta[j] = column.has_value(j);
+    delta_data = db_delta.data();
+  }
+  MultShare delta(mcirc, delta_data, delta_bitlen(), SERVER, dbsize_);
 
   // Set hammingweight input share only for bitmasks
   BoolShare _hw;
   if (f.comparator == BM) {
-    auto value_hws = transform_vec(values, hw);
-    _hw = BoolShare(bcirc,
-        value_hws.data(), hw_size(f.bitsize), SERVER, dbsize_);
+    _hw = BoolShare(bcirc, const_cast<FieldColumn::HammingWeight*>(column.hws()),
+        hw_size(f.bitsize), SERVER, dbsize_);
+  }
+
+  // In batched mode, the database is repeated once for each client record
+  if (const size_t nseg = nsegments(); nseg > 1) {
+    val = vcombine<BoolShare>(vector<BoolShare>(nseg, val));
+    delta = vcombine<MultShare>(vector<MultShare>(nseg, delta));
+    if (!_hw.is_null()) _hw = vcombine<BoolShare>(vector<BoolShare>(nseg, _hw));
   }
 
 #ifdef DEBUG_SEL_CIRCUIT
-    print_share(val, format("server val[{}]", i));
-    print_share(delta, format("server delta[{}]", i));
-    if (f.comparator == BM) print_share(_hw, format("server hw[{}]", i));
+    print_share(val, format("server val[{}]", f.name));
+    print_share(delta, format("server delta[{}]", f.name));
+    if (f.comparator == BM) print_share(_hw, format("server hw[{}]", f.name));
 #endif
 
   return {move(val), move(delta), move(_hw)};
@@ -220,7 +312,9 @@ EntryShare<MultShare> CircuitInput<MultShare>::make_server_entries_share(const E
 
 template <class MultShare>
 VEntryShare<MultShare> CircuitInput<MultShare>::make_client_entry_shares(
-    const EpilinkClientInput& input, const FieldName& i) {
+    const EpilinkClientInput& input, FieldId i) {
+  if (cfg.batch_records) return {make_client_entries_share(input, i)};
+
   VEntryShare<MultShare> entry_shares;
   entry_shares.reserve(nrecords_);
   for (size_t j = 0; j != nrecords_; ++j) {
@@ -231,62 +325,122 @@ VEntryShare<MultShare> CircuitInput<MultShare>::make_client_entry_shares(
 
 template <class MultShare>
 EntryShare<MultShare> CircuitInput<MultShare>::make_client_entry_share(const EpilinkClientInput& input,
-    const FieldName& i, size_t index) {
-  const auto& f = cfg.epi.fields.at(i);
-  const FieldEntry& entry = input.records->at(index).at(i);
+    FieldId i, size_t index) {
+  const auto& f = cfg.epi.field_specs[i];
+  const FieldEntry& entry = input.records->at(index).at(f.name);
   size_t bytesize = bitbytes(f.bitsize);
   Bitmask value = entry.value_or(Bitmask(bytesize));
-  check_vector_size(value, bytesize, "client input byte vector "s + i);
+  check_vector_size(value, bytesize, "client input byte vector "s + f.name);
 
   // value
-  BoolShare val(bcirc,
-      repeat_vec(value, dbsize_).data(),
-      f.bitsize, CLIENT, dbsize_);
+  BoolShare val(bcirc, value.data(), f.bitsize, CLIENT, 1);
 
   // delta
-  MultShare delta(mcirc,
-      vector<CircUnit>(dbsize_, static_cast<CircUnit>(entry.has_value())).data(),
-      delta_bitlen, CLIENT, dbsize_);
+  CircUnit delta_value = entry.has_value();
+  MultShare delta(mcirc, &delta_value, delta_bitlen(), CLIENT, 1);
 
   // Set hammingweight input share only for bitmasks
   BoolShare _hw;
   if (f.comparator == BM) {
-    _hw = BoolShare(bcirc,
-        vector<CircUnit>(dbsize_, hw(value)).data(),
-        hw_size(f.bitsize), CLIENT, dbsize_);
+    CircUnit hw_value = hw(value);
+    _hw = BoolShare(bcirc, &hw_value, hw_size(f.bitsize), CLIENT, 1);
   }
 
 #ifdef DEBUG_SEL_CIRCUIT
-    print_share(val, format("client[{}] val[{}]", index, i));
-    print_share(delta, format("client[{}] delta[{}]", index, i));
-    if (f.comparator == BM) print_share(_hw, format("client[{}] hw[{}]", index, i));
+    print_share(val, format("client[{}] val[{}]", index, f.name));
+    print_share(delta, format("client[{}] delta[{}]", index, f.name));
+    if (f.comparator == BM) print_share(_hw, format("client[{}] hw[{}]", index, f.name));
 #endif
 
-  return {move(val), move(delta), move(_hw)};
+  return broadcast({move(val), move(delta), move(_hw)});
 }
 
 template <class MultShare>
-EntryShare<MultShare> CircuitInput<MultShare>::make_dummy_entry_share(const FieldName& i) {
-  const auto& f = cfg.epi.fields.at(i);
+EntryShare<MultShare> CircuitInput<MultShare>::make_client_entries_share(
+    const EpilinkClientInput& input, FieldId i) {
+  const auto& f = cfg.epi.field_specs[i];
+  size_t bytesize = bitbytes(f.bitsize);
+  Bitmask dummy_bm(bytesize);
+
+  // One value per record, broadcast to record-major layout below
+  VBitmask values;
+  vector<CircUnit> deltas, hws;
+  values.reserve(nrecords_);
+  deltas.reserve(nrecords_);
+  hws.reserve(nrecords_);
+  for (size_t j = 0; j != nrecords_; ++j) {
+    const FieldEntry& entry = input.records->at(j).at(f.name);
+    Bitmask value = entry.value_or(dummy_bm);
+    check_vector_size(value, bytesize, "client input byte vector "s + f.name);
+    values.emplace_back(move(value));
+    deltas.emplace_back(entry.has_value());
+    if (f.comparator == BM) hws.emplace_back(hw(values.back()));
+  }
 
-  BoolShare val(bcirc, f.bitsize, dbsize_); //dummy val
+  // value
+  BoolShare val(bcirc, concat_vec(values).data(), f.bitsize, CLIENT, nrecords_);
 
-  MultShare delta(mcirc, delta_bitlen, dbsize_); // dummy delta
+  // delta
+  MultShare delta(mcirc, deltas.data(), delta_bitlen(), CLIENT, nrecords_);
 
+  // Set hammingweight input share only for bitmasks
   BoolShare _hw;
   if (f.comparator == BM) {
-    _hw = BoolShare(bcirc, hw_size(f.bitsize), dbsize_); //dummy hw
+    _hw = BoolShare(bcirc, hws.data(), hw_size(f.bitsize), CLIENT, nrecords_);
   }
 
 #ifdef DEBUG_SEL_CIRCUIT
-    print_share(val, format("dummy val[{}]", i));
-    print_share(delta, format("dummy delta[{}]", i));
-    if (f.comparator == BM) print_share(_hw, format("dummy hw[{}]", i));
+    print_share(val, format("client[*] val[{}]", f.name));
+    print_share(delta, format("client[*] delta[{}]", f.name));
+    if (f.comparator == BM) print_share(_hw, format("client[*] hw[{}]", f.name));
+#endif
+
+  return broadcast({move(val), move(delta), move(_hw)});
+}
+
+template <class MultShare>
+EntryShare<MultShare> CircuitInput<MultShare>::make_dummy_entry_share(FieldId i,
+    size_t nvals) {
+  const auto& f = cfg.epi.field_specs[i];
+
+  BoolShare val(bcirc, f.bitsize, nvals); //dummy val
+
+  MultShare delta(mcirc, delta_bitlen(), nvals); // dummy delta
+
+  BoolShare _hw;
+  if (f.comparator == BM) {
+    _hw = BoolShare(bcirc, hw_size(f.bitsize), nvals); //dummy hw
+  }
+
+#ifdef DEBUG_SEL_CIRCUIT
+    print_share(val, format("dummy val[{}]", f.name));
+    print_share(delta, format("dummy delta[{}]", f.name));
+    if (f.comparator == BM) print_share(_hw, format("dummy hw[{}]", f.name));
 #endif
 
   return {move(val), move(delta), move(_hw)};
 }
 
+template <class MultShare>
+EntryShare<MultShare> CircuitInput<MultShare>::broadcast(
+    EntryShare<MultShare>&& entry) const {
+  if (dbsize_ == 1) return move(entry);
+  return {broadcast(entry.val), broadcast(entry.delta),
+    entry.hw.is_null() ? move(entry.hw) : broadcast(entry.hw)};
+}
+
+template <class MultShare>
+template <class ShareT>
+ShareT CircuitInput<MultShare>::broadcast(const ShareT& s) const {
+  if (s.get_nvals() == 1) return s.repeat(dbsize_);
+  // Repeater gates only repeat single values, so each record is broadcast
+  // individually and combined in record-major order
+  vector<ShareT> repeated;
+  repeated.reserve(s.get_nvals());
+  for (const auto& record : s.split(1)) repeated.emplace_back(record.repeat(dbsize_));
+  return vcombine<ShareT>(repeated);
+}
+
 template class CircuitInput<BoolShare>;
 template class CircuitInput<ArithShare>;
 
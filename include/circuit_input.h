@@ -47,13 +47,36 @@ struct ComparisonShares {
 
 struct ComparisonIndex {
   size_t left_idx;
-  const FieldName left, right;
+  FieldId left, right;
 };
 
-// We want to use ComparisonIndex as map keys
-bool operator<(const ComparisonIndex& l, const ComparisonIndex& r);
+/**
+ * This party's shares of the best score and index of a record over all
+ * previously linked database chunks.
+ */
+struct LinkageCarry {
+  CircUnit num, den, index;
+};
 
-using FieldNamePair = std::pair<FieldName, FieldName>;
+/**
+ * Position of the current chunk in the full database during chunked linkage,
+ * together with the carried results of all previous chunks, one per client
+ * record. carry is empty for the first chunk.
+ */
+struct ChunkInfo {
+  size_t offset{0};
+  size_t total_database_size{0};
+  std::vector<LinkageCarry> carry;
+};
+
+/**
+ * Carried results of previous chunks, reassembled as shares
+ */
+template <class MultShare>
+struct CarryShares {
+  MultShare num, den;
+  BoolShare index;
+};
 
 template <class MultShare>
 class CircuitInput {
@@ -68,19 +91,61 @@ class CircuitInput {
 #endif
     void clear();
 
+    /**
+     * Sets the chunk to be linked next. Must be called before set().
+     */
+    void set_chunk(ChunkInfo&& chunk);
+    bool has_carry() const { return !chunk_.carry.empty(); }
+    /**
+     * Returns the carried best results of the records of record share index.
+     * Numerators and denominators are input with the given bitlens, so that
+     * they fit the scores of the current chunk.
+     */
+    CarryShares<MultShare> get_carry(size_t index,
+        size_t num_bits, size_t den_bits) const;
+
     bool is_input_set() const { return input_set; }
     size_t dbsize() const { return dbsize_; }
     size_t nrecords() const { return nrecords_; }
+    /**
+     * Number of client record entry shares per field. In batched mode, all
+     * records are stacked into a single SIMD share, otherwise each record has
+     * its own share.
+     */
+    size_t nrecord_shares() const { return cfg.batch_records ? 1 : nrecords_; }
+    /**
+     * Number of consecutive segments of size dbsize in each entry share, over
+     * which the best match is determined independently.
+     */
+    size_t nsegments() const { return cfg.batch_records ? nrecords_ : 1; }
+    /**
+     * nvals of all entry shares and constants
+     */
+    size_t nvals() const { return nsegments() * dbsize_; }
     ComparisonShares<MultShare> get(const ComparisonIndex& i) const;
     const MultShare& get_const_weight(const ComparisonIndex& i) const;
     const BoolShare& const_idx() const { return const_idx_; }
     const MultShare& const_dice_prec_factor() const { return const_dice_prec_factor_; }
     const MultShare& const_threshold() const { return const_threshold_; }
     const MultShare& const_tthreshold() const { return const_tthreshold_; }
+    /**
+     * Thresholds with the given nvals, to compare individual scores instead of
+     * the folded ones
+     */
+    MultShare const_threshold(size_t nvals) const;
+    MultShare const_tthreshold(size_t nvals) const;
 
   private:
     inline static constexpr bool do_arith_mult = std::is_same_v<MultShare, ArithShare>;
-    inline static constexpr size_t delta_bitlen = do_arith_mult ? BitLen : 1;
+    size_t delta_bitlen() const { return const_bitlen(1); }
+    /**
+     * Bitlen of constants whose values fit into the given bits. Arithmetic
+     * constants fill the whole ring of the circuit's word size, boolean ones
+     * only need as many wires.
+     */
+    size_t const_bitlen(size_t bits) const {
+      return do_arith_mult ? cfg.bitlen : bits;
+    }
     using MultCircuit = std::conditional_t<do_arith_mult, ArithmeticCircuit, BooleanCircuit>;
 
     const CircuitConfig& cfg;
@@ -88,6 +153,8 @@ class CircuitInput {
     ArithmeticCircuit* acirc;
     MultCircuit* mcirc;
     bool input_set{false};
+    e_role role{ALL}; // which party's inputs are set
+    ChunkInfo chunk_;
 
     size_t dbsize_{0};
     size_t nrecords_{0};
@@ -95,24 +162,39 @@ class CircuitInput {
     BoolShare const_idx_;
     MultShare const_dice_prec_factor_;
     // Left side of inequality: T * sum(weights)
+    CircUnit threshold_{0}, tthreshold_{0};
     MultShare const_threshold_, const_tthreshold_;
-    mutable std::map<FieldNamePair, MultShare> weight_cache;
+    // by left * nfields + right, null if not yet created
+    mutable std::vector<MultShare> weight_cache;
 
-    std::map<FieldName, VEntryShare<MultShare>> left_shares;
-    std::map<FieldName, EntryShare<MultShare>> right_shares;
+    // by FieldId
+    std::vector<VEntryShare<MultShare>> left_shares;
+    std::vector<EntryShare<MultShare>> right_shares;
 
     void set_constants(size_t database_size, size_t num_records);
+    template <class ShareT, class CircT>
+    ShareT reshare(CircT* circ, std::vector<CircUnit> vals, size_t bitlen) const;
     void set_real_client_input(const EpilinkClientInput& input);
     void set_real_server_input(const EpilinkServerInput& input);
     void set_dummy_client_input();
     void set_dummy_server_input();
     EntryShare<MultShare> make_server_entries_share(const EpilinkServerInput& input,
-        const FieldName& i);
+        FieldId i);
     VEntryShare<MultShare> make_client_entry_shares(const EpilinkClientInput& input,
-        const FieldName& i);
+        FieldId i);
     EntryShare<MultShare> make_client_entry_share(const EpilinkClientInput& input,
-        const FieldName& i, size_t index);
-    EntryShare<MultShare> make_dummy_entry_share(const FieldName& i);
+        FieldId i, size_t index);
+    EntryShare<MultShare> make_client_entries_share(const EpilinkClientInput& input,
+        FieldId i);
+    EntryShare<MultShare> make_dummy_entry_share(FieldId i, size_t nvals);
+    /**
+     * Repeats each value of the client's entry shares dbsize times with
+     * repeater gates, so that client inputs are entered once per record,
+     * independent of the database size.
+     */
+    EntryShare<MultShare> broadcast(EntryShare<MultShare>&& entry) const;
+    template <class ShareT>
+    ShareT broadcast(const ShareT& s) const;
 };
 
 } /* end of namespace: sel */
@@ -126,7 +208,7 @@ struct formatter<sel::ComparisonIndex> {
 
   template <typename FormatContext>
   auto format(const sel::ComparisonIndex& i, FormatContext &ctx) {
-    return format_to(ctx.begin(),"[{}]({}|{})", i.left_idx, i.left, i.right);
+    return format_to(ctx.out(),"[{}]({}|{})", i.left_idx, i.left, i.right);
   }
 };
 
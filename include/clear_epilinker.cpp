@@ -21,6 +21,7 @@
 #include <iostream>
 #include "util.h"
 #include "clear_epilinker.h"
+#include "linkage_plan.h"
 
 using namespace std;
 using fmt::print, fmt::format;
@@ -92,10 +93,27 @@ Input::Input(const Record& record,
   dbsize{(*database.cbegin()).second.size()}
 {
   for (const auto& col : database) {
-    check_vector_size(col.second, dbsize, "Database column "s + col.first);
+    check_column_size(col.second, dbsize, "Database column "s + col.first);
   }
 }
 
+/**
+ * Input entries by FieldId, so that field names are only looked up once
+ */
+struct FieldInput {
+  vector<const FieldEntry*> record;
+  vector<const FieldColumn*> database;
+
+  FieldInput(const Input& input, const EpilinkConfig& epi) {
+    record.reserve(epi.nfields);
+    database.reserve(epi.nfields);
+    for (const auto& f : epi.field_specs) {
+      record.emplace_back(&input.record.at(f.name));
+      database.emplace_back(&input.database.at(f.name));
+    }
+  }
+};
+
 /******************** Comparators & Threshold ********************
  * Comparators and threshold introduce a left-shift for integer calculation but
  * don't for exact double calculation.
@@ -114,11 +132,15 @@ T scale(T val, size_t prec) {
  * (x+(y/2))/y, because x/y always rounds down, which would lead to a bias.
  */
 template<typename T>
-T dice(const Bitmask& left, const Bitmask& right, size_t prec) {
-  T hw_plus = hw(left) + hw(right);
+T dice(const Bitmask& left, const FieldColumn& right, size_t idx, size_t prec) {
+  T hw_plus = hw(left) + right.hw(idx);
   if (hw_plus == 0) return 0;
 
-  T hw_and = hw(bm_and(left, right));
+  const uint8_t* right_value = right.value(idx);
+  T hw_and = 0;
+  for (size_t i = 0; i != left.size(); ++i) {
+    hw_and += __builtin_popcount(left[i] & right_value[i]);
+  }
   T numerator;
   if constexpr (is_integral_v<T>) {
     numerator = (hw_and << (prec+1)) + (hw_plus>>1);
@@ -133,15 +155,16 @@ T dice(const Bitmask& left, const Bitmask& right, size_t prec) {
 }
 
 template<typename T>
-T equality(const Bitmask& left, const Bitmask& right, size_t prec) {
-  return ((left == right) ? scale<T>(1, prec) : 0);
+T equality(const Bitmask& left, const FieldColumn& right, size_t idx, size_t prec) {
+  return (equal(left.cbegin(), left.cend(), right.value(idx)) ?
+      scale<T>(1, prec) : 0);
 }
 
 template<typename T>
 bool test_threshold(const FieldWeight<T>& q, const double thr, const size_t prec) {
   T threshold;
   if constexpr (is_integral_v<T>) {
-    threshold = llround(thr * (1 << prec));
+    threshold = llround(thr * (1ULL << prec));
   } else {
     threshold = thr;
   }
@@ -149,30 +172,31 @@ bool test_threshold(const FieldWeight<T>& q, const double thr, const size_t prec
 }
 
 template<typename T>
-T scaled_weight(const FieldName& ileft, const FieldName& iright, const CircuitConfig& cfg) {
+T scaled_weight(const FieldComparison& c) {
   if constexpr (is_integral_v<T>) {
-    return cfg.rescaled_weight(ileft, iright);
+    return c.rescaled_weight;
   } else {
-    return (cfg.epi.fields.at(ileft).weight + cfg.epi.fields.at(iright).weight)/2;
+    return c.weight;
   }
 }
 
 /******************** Algorithm Flow Components ********************/
 template<typename T>
-FieldWeight<T> field_weight(const Input& input, const CircuitConfig& cfg,
-    const size_t idx, const FieldName& ileft, const FieldName& iright) {
-  const FieldComparator ftype = cfg.epi.fields.at(ileft).comparator;
+FieldWeight<T> field_weight(const FieldInput& input, const CircuitConfig& cfg,
+    const size_t idx, const FieldComparison& c) {
+  const FieldId ileft = c.left, iright = c.right;
+  const FieldComparator ftype = cfg.epi.field_specs[ileft].comparator;
 
   // 1. Check if both entries have values
-  const FieldEntry& client_entry = input.record.at(ileft);
-  const FieldEntry& server_entry = input.database.at(iright)[idx];
-  const bool delta = (client_entry.has_value() && server_entry.has_value());
+  const FieldEntry& client_entry = *input.record[ileft];
+  const FieldColumn& server_column = *input.database[iright];
+  const bool delta = (client_entry.has_value() && server_column.has_value(idx));
   if (!delta){
 #ifdef DEBUG_SEL_CLEAR
     string who = "both";
     if (client_entry.has_value()) {
       who = "right";
-    } else if (server_entry.has_value()) {
+    } else if (server_column.has_value(idx)) {
       who = "left";
     }
     print("({}|{}|{})[{}] <{} empty>\n", ftype, ileft, iright, idx, who);
@@ -180,16 +204,16 @@ FieldWeight<T> field_weight(const Input& input, const CircuitConfig& cfg,
     return {0, 0};
   }
 
-  const T weight = scaled_weight<T>(ileft, iright, cfg);
+  const T weight = scaled_weight<T>(c);
   // 2. Compare values
   T comp;
   switch(ftype) {
     case BM: {
-      comp = dice<T>(client_entry.value(), server_entry.value(), cfg.dice_prec);
+      comp = dice<T>(client_entry.value(), server_column, idx, cfg.dice_prec);
       break;
     }
     case BIN: {
-      comp = equality<T>(client_entry.value(), server_entry.value(), cfg.dice_prec);
+      comp = equality<T>(client_entry.value(), server_column, idx, cfg.dice_prec);
       break;
     }
   }
@@ -223,42 +247,36 @@ void print_score(const string& pfx, const Ref& r,
 #endif
 
 template<typename T>
-FieldWeight<T> best_group_weight(const Input& input, const CircuitConfig& cfg,
-    const size_t idx, const IndexSet& group_set) {
-  vector<FieldName> group{begin(group_set), end(group_set)};
-  // copy group to store permutations
-  vector<FieldName> groupPerm = group;
-  size_t size = group.size();
-
+FieldWeight<T> best_group_weight(const vector<FieldWeight<T>>& comparison_weights,
+    const LinkagePlan::ExchangeGroup& group, const CircuitConfig& cfg,
+    const size_t idx) {
+  __ignore(cfg);
+  __ignore(idx);
 #ifdef DEBUG_SEL_CLEAR
-  print("---------- Group {} [{}]----------\n", group, idx);
-  vector<FieldName> groupBest;
+  print("---------- Group {} [{}]----------\n", group.fields, idx);
+  const LinkagePlan::ComparisonIds* groupBest = nullptr;
 #endif
 
-  // iterate over all group permutations and calc field-weight
+  // iterate over all group permutations and sum their field-weights
   FieldWeight<T> best_perm;
-  do {
+  for (const auto& perm : group.permutations) {
     FieldWeight<T> score;
-    for (size_t i = 0; i != size; ++i) {
-      const auto& ileft = group[i];
-      const auto& iright = groupPerm[i];
-      score += field_weight<T>(input, cfg, idx, ileft, iright);
-    }
+    for (const auto c : perm) score += comparison_weights[c];
 
 #ifdef DEBUG_SEL_CLEAR
-  print_score("Permutation", groupPerm, score, cfg.dice_prec);
+  print_score("Permutation", perm, score, cfg.dice_prec);
 #endif
 
     if (best_perm < score) {
       best_perm = score;
 #ifdef DEBUG_SEL_CLEAR
-      groupBest = groupPerm;
+      groupBest = &perm;
 #endif
     }
-  } while(next_permutation(groupPerm.begin(), groupPerm.end()));
+  }
 
 #ifdef DEBUG_SEL_CLEAR
-  print_score("Best group:", groupBest, best_perm, cfg.dice_prec);
+  if (groupBest) print_score("Best group:", *groupBest, best_perm, cfg.dice_prec);
 #endif
 
   return best_perm;
@@ -266,44 +284,43 @@ FieldWeight<T> best_group_weight(const Input& input, const CircuitConfig& cfg,
 
 template<typename T>
 Result<T> calc(const Input& input, const CircuitConfig& cfg) {
-  // Check for integral types that cfg.bitlen matches the type's bitlength
+  return calc<T>(input, cfg, LinkagePlan{cfg});
+}
+
+template<typename T>
+Result<T> calc(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan) {
+  // Check for integral types that cfg.bitlen fits into the type's bitlength
   if constexpr (is_integral_v<T>) {
-    if (cfg.bitlen != sizeof(T) * 8) {
+    if (cfg.bitlen > sizeof(T) * 8) {
       print(cerr,
-          "Warning: CircuitConfig's bitlength {} doesn't match the type's {}. "
-          "You may want to match them.\n", cfg.bitlen, sizeof(T)*8);
+          "Warning: CircuitConfig's bitlength {} exceeds the type's {}. "
+          "Calculations may overflow.\n", cfg.bitlen, sizeof(T)*8);
     }
   }
 
   const size_t dbsize = input.dbsize;
+  const FieldInput field_input{input, cfg.epi};
 
   // Accumulator of individual field_weights
   vector<FieldWeight<T>> scores(dbsize);
+  // Field weights of all comparisons of the plan for current database entry
+  vector<FieldWeight<T>> comparison_weights(plan.comparisons.size());
 
-  // 1. Field weights of individual fields
-  // 1.1 For all exchange groups, find the permutation with the highest score
-  // Where we collect indices not already used in an exchange group
-  IndexSet no_x_group;
-  // fill with field names, remove later
-  for (const auto& field : cfg.epi.fields) no_x_group.insert(field.first);
-  // for each group, store the best permutation's weight into field_weights
-  for (const auto& group : cfg.epi.exchange_groups) {
-    // add this group's field weight to vector
-    for (size_t idx = 0; idx != dbsize; ++idx) {
-      scores[idx] += best_group_weight<T>(input, cfg, idx, group);
+  for (size_t idx = 0; idx != dbsize; ++idx) {
+    // 1. Field weights of all comparisons
+    for (size_t c = 0; c != plan.comparisons.size(); ++c) {
+      comparison_weights[c] = field_weight<T>(field_input, cfg, idx, plan.comparisons[c]);
     }
-    // remove all indices that were covered by this index group
-    for (const auto& i : group) no_x_group.erase(i);
-  }
 
-#ifdef DEBUG_SEL_CLEAR
-  print("---------- No-X-Group {} ----------\n", no_x_group);
-#endif
+    // 1.1 For all exchange groups, find the permutation with the highest score
+    for (const auto& group : plan.exchange_groups) {
+      scores[idx] += best_group_weight<T>(comparison_weights, group, cfg, idx);
+    }
 
-  // 1.2 Remaining indices
-  for (const auto& i : no_x_group) {
-    for (size_t idx = 0; idx != dbsize; ++idx) {
-      scores[idx] += field_weight<T>(input, cfg, idx, i, i);
+    // 1.2 Remaining indices not in any exchange group
+    for (const auto c : plan.single_comparisons) {
+      scores[idx] += comparison_weights[c];
     }
   }
 
@@ -331,6 +348,14 @@ Result<T> calc(const Input& input, const CircuitConfig& cfg) {
 }
 
 // calc template instantiations for integral types
+template Result<uint8_t> calc<uint8_t>(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan);
+template Result<uint16_t> calc<uint16_t>(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan);
+template Result<uint32_t> calc<uint32_t>(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan);
+template Result<uint64_t> calc<uint64_t>(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan);
 template Result<uint8_t> calc<uint8_t>(const Input& input, const CircuitConfig& cfg);
 template Result<uint16_t> calc<uint16_t>(const Input& input, const CircuitConfig& cfg);
 template Result<uint32_t> calc<uint32_t>(const Input& input, const CircuitConfig& cfg);
@@ -346,8 +371,9 @@ Result<double> calc_exact(const Input& input, const CircuitConfig& cfg) {
 // vectorized records
 template<typename T> std::vector<Result<T>> calc(const Records& records,
     const VRecord& database, const CircuitConfig& cfg) {
-  return transform_vec(records, [&database, &cfg](const auto& record) {
-      return calc<T>({record, database}, cfg);
+  const LinkagePlan plan{cfg};
+  return transform_vec(records, [&database, &cfg, &plan](const auto& record) {
+      return calc<T>({record, database}, cfg, plan);
       });
 }
 
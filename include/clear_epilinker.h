@@ -23,6 +23,10 @@
 #include "circuit_config.h"
 #include "epilink_result.hpp"
 
+namespace sel {
+struct LinkagePlan;
+}
+
 namespace sel::clear_epilink {
 
 /**
@@ -55,6 +59,12 @@ Result<CircUnit> calc_integer(const Input& input, const CircuitConfig& cfg);
 Result<double> calc_exact(const Input& input, const CircuitConfig& cfg);
 
 template<typename T> Result<T> calc(const Input& input, const CircuitConfig& cfg);
+/**
+ * Like calc(input, cfg), but with a precompiled LinkagePlan of cfg, e.g., to
+ * link many records against the same database.
+ */
+template<typename T> Result<T> calc(const Input& input, const CircuitConfig& cfg,
+    const LinkagePlan& plan);
 template<typename T> std::vector<Result<T>> calc(const Records& records,
     const VRecord& database, const CircuitConfig& cfg);
 template<typename T> CountResult<size_t> calc_count(const Records& records,
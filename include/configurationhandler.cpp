@@ -83,11 +83,17 @@ ServerConfig ConfigurationHandler::get_server_config() const {
 CircuitConfig make_circuit_config(const shared_ptr<const LocalConfiguration>& local_config,
                                   const shared_ptr<const RemoteConfiguration>& remote_config){
 auto server_config{ConfigurationHandler::cget().get_server_config()};
-return {local_config->get_epilink_config(),
+CircuitConfig cfg{local_config->get_epilink_config(),
   server_config.circuit_directory,
   remote_config->get_matching_mode(),
   server_config.boolean_sharing,
-  server_config.use_circuit_conversion};
+  server_config.use_circuit_conversion,
+  server_config.word_size};
+cfg.batch_records = server_config.batch_records;
+cfg.chunk_size = server_config.chunk_size;
+cfg.max_exchanged_fields = server_config.max_exchanged_fields;
+cfg.use_int_div_files = server_config.use_int_div_files;
+return cfg;
 }
 
 nlohmann::json ConfigurationHandler::make_comparison_config(const RemoteId& remote_id) const {
@@ -105,6 +111,13 @@ nlohmann::json ConfigurationHandler::make_comparison_config(const RemoteId& remo
   lock_guard<shared_mutex> remote_lock(m_remote_mutex);
   server_config["matchingMode"] = m_remote_configs.at(remote_id)->get_matching_mode();
   }
+  // Both parties need to build the same circuit layout
+  server_config["batchRecords"] = m_server_config.batch_records;
+  server_config["linkageChunkSize"] = m_server_config.chunk_size;
+  server_config["maxExchangedFields"] = m_server_config.max_exchanged_fields;
+  server_config["useIntDivFiles"] = m_server_config.use_int_div_files;
+  server_config["autoSharing"] = m_server_config.auto_sharing;
+  server_config["circuitWordSize"] = m_server_config.word_size;
   return server_config;
 }
 bool ConfigurationHandler::compare_configuration(const nlohmann::json& client_config, const RemoteId& remote_id) const{
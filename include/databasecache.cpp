@@ -0,0 +1,205 @@
+/**
+\file    databasecache.cpp
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Latest databases of the remotes, kept current by polling
+*/
+
+#include "databasecache.h"
+#include "logger.h"
+#include <stdexcept>
+
+using namespace std;
+namespace sel {
+
+DatabaseCache::DatabaseCache(function<Policy()> policy, Fetcher fetch,
+    SnapshotLoader load_snapshot, SnapshotSaver save_snapshot)
+    : m_policy{move(policy)},
+      m_fetch{move(fetch)},
+      m_load_snapshot{move(load_snapshot)},
+      m_save_snapshot{move(save_snapshot)} {}
+
+DatabaseCache::~DatabaseCache() {
+  {
+    lock_guard<mutex> lock(m_refresh_mutex);
+    m_stop_refreshing = true;
+  }
+  m_refresh_cond.notify_all();
+  for (auto& refresher : m_refreshers) refresher.second.join();
+}
+
+std::mutex& DatabaseCache::sync_mutex(const RemoteId& remote_id) {
+  lock_guard<mutex> lock(m_db_mutex);
+  return m_sync_mutexes.try_emplace(remote_id).first->second;
+}
+
+bool DatabaseCache::full_sync_due(const ServerData& data) const {
+  const auto interval{m_policy().full_sync_interval};
+  return interval.count()
+    && chrono::system_clock::now() - data.full_sync_time >= interval;
+}
+
+size_t DatabaseCache::poll_database(const RemoteId& remote_id) {
+  lock_guard<mutex> lock(sync_mutex(remote_id));
+  return poll_full(remote_id);
+}
+
+size_t DatabaseCache::poll_database_diff(const RemoteId& remote_id) {
+  lock_guard<mutex> lock(sync_mutex(remote_id));
+  return poll_diff(remote_id);
+}
+
+size_t DatabaseCache::poll_full(const RemoteId& remote_id) {
+  const auto sync_start{chrono::system_clock::now()};
+  auto data{m_fetch(remote_id, nullopt)};
+  data.full_sync_time = sync_start;
+  const auto cached{get_database(remote_id)};
+  const bool changed{!cached || *cached->data != *data.data};
+  return store_database(remote_id, move(data), cached, changed);
+}
+
+size_t DatabaseCache::poll_diff(const RemoteId& remote_id) {
+  auto cached{get_database(remote_id)};
+  // After a restart, only the changes since the last snapshot are fetched
+  if (!cached) cached = load_snapshot(remote_id);
+  // Changed records can only be matched by their ids and deleted records only
+  // vanish with a full poll
+  if (!cached || !cached->ids || full_sync_due(*cached)) {
+    return poll_full(remote_id);
+  }
+  auto diff{m_fetch(remote_id, cached->todate)};
+  const bool changed{diff.ids && !diff.ids->empty()};
+  get_logger(ComponentLogger::REST)->debug("{} records of remote {} changed "
+      "since {}", changed ? diff.ids->size() : 0, remote_id, cached->todate);
+  auto data{changed ? merge_database_diff(*cached, move(diff))
+    : ServerData{cached->data, cached->ids, diff.todate, cached->local_id,
+      cached->remote_id, nullptr, chrono::steady_clock::now(),
+      cached->full_sync_time}};
+  return store_database(remote_id, move(data), cached, changed);
+}
+
+size_t DatabaseCache::store_database(const RemoteId& remote_id,
+    ServerData&& data, const shared_ptr<const ServerData>& cached,
+    bool changed) {
+  if (!data.ids) {
+    throw runtime_error("Cannot cache a database of remote " + remote_id
+        + " without record ids");
+  }
+  if (changed) {
+    const size_t version{cached ? cached->prepared->version + 1 : 0};
+    get_logger(ComponentLogger::REST)->debug("Preparing database version {} "
+        "for remote {}", version, remote_id);
+    data.prepared = make_shared<const PreparedDatabase>(*data.data, version);
+  } else {
+    data.prepared = cached->prepared;
+  }
+  const size_t database_size{data.data->begin()->second.size()};
+  auto stored{make_shared<const ServerData>(move(data))};
+  {
+    lock_guard<mutex> lock(m_db_mutex);
+    m_databases[remote_id] = stored;
+  }
+  // Unchanged databases keep their older snapshot, from whose toDate a
+  // restart fetches only a few more records, unless a full poll has to be
+  // recorded
+  if (m_save_snapshot
+      && (changed || stored->full_sync_time != cached->full_sync_time)) {
+    m_save_snapshot(remote_id, *stored);
+  }
+  return database_size;
+}
+
+shared_ptr<const ServerData> DatabaseCache::load_snapshot(
+    const RemoteId& remote_id) {
+  if (!m_load_snapshot) return nullptr;
+  auto data{m_load_snapshot(remote_id)};
+  if (!data) return nullptr;
+  auto logger{get_logger(ComponentLogger::REST)};
+  if (!data->ids) {
+    logger->info("Ignoring database snapshot of remote {} without record ids",
+        remote_id);
+    return nullptr;
+  }
+  // It may still hold records deleted since
+  if (full_sync_due(*data)) {
+    logger->info("Ignoring database snapshot of remote {} from before the "
+        "last due full sync", remote_id);
+    return nullptr;
+  }
+  data->prepared = make_shared<const PreparedDatabase>(*data->data, 0);
+  logger->info("Loaded database snapshot of remote {} with {} records up to "
+      "{}", remote_id, data->data->begin()->second.size(), data->todate);
+  lock_guard<mutex> lock(m_db_mutex);
+  return m_databases.try_emplace(remote_id,
+      make_shared<const ServerData>(move(*data))).first->second;
+}
+
+shared_ptr<const ServerData> DatabaseCache::get_current_database(
+    const RemoteId& remote_id) {
+  const auto policy{m_policy()};
+  const auto request_time{chrono::steady_clock::now()};
+  if (policy.refresh_interval.count()) {
+    // Bounded, so that failing refreshes don't serve arbitrarily old data
+    const auto max_staleness{policy.max_staleness.count()
+      ? policy.max_staleness : 3 * policy.refresh_interval};
+    if (auto cached{get_database(remote_id)};
+        cached && request_time - cached->fetch_time <= max_staleness) {
+      return cached;
+    }
+  }
+  lock_guard<mutex> lock(sync_mutex(remote_id));
+  if (auto cached{get_database(remote_id)};
+      cached && cached->fetch_time >= request_time) {
+    return cached;
+  }
+  poll_diff(remote_id);
+  return get_database(remote_id);
+}
+
+void DatabaseCache::start_refresher(const RemoteId& remote_id) {
+  const auto interval{m_policy().refresh_interval};
+  if (!interval.count()) return;
+  lock_guard<mutex> lock(m_refresh_mutex);
+  if (m_stop_refreshing || m_refreshers.count(remote_id)) return;
+  get_logger(ComponentLogger::REST)->info("Refreshing database of remote {} "
+      "every {}s", remote_id, interval.count());
+  m_refreshers.emplace(remote_id,
+      thread{&DatabaseCache::refresh_database, this, remote_id, interval});
+}
+
+void DatabaseCache::refresh_database(const RemoteId& remote_id,
+    chrono::seconds interval) {
+  auto logger{get_logger(ComponentLogger::REST)};
+  unique_lock<mutex> lock(m_refresh_mutex);
+  while (!m_stop_refreshing) {
+    lock.unlock();
+    try {
+      poll_database_diff(remote_id);
+    } catch (const exception& e) {
+      logger->error("Error refreshing database of remote {}: {}", remote_id,
+          e.what());
+    }
+    lock.lock();
+    m_refresh_cond.wait_for(lock, interval, [this]{ return m_stop_refreshing; });
+  }
+}
+
+std::shared_ptr<const ServerData> DatabaseCache::get_database(
+    const RemoteId& remote_id) const {
+  lock_guard<mutex> lock(m_db_mutex);
+  const auto it{m_databases.find(remote_id)};
+  return it == m_databases.end() ? nullptr : it->second;
+}
+
+}  // namespace sel
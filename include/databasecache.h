@@ -0,0 +1,139 @@
+/**
+\file    databasecache.h
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Latest databases of the remotes, kept current by polling
+*/
+
+#ifndef SEL_DATABASECACHE_H
+#define SEL_DATABASECACHE_H
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "serverdata.h"
+
+namespace sel {
+
+/**
+ * Caches the latest database of each remote. Full polls fetch the whole
+ * database, diff polls only the records changed since the cached one and merge
+ * them. Polls of the same remote are serialized, so that no merge of an older
+ * database overwrites a newer one.
+ *
+ * All jobs share the cached databases, so every poll fetches the record ids,
+ * which linkage jobs need to report their results.
+ */
+class DatabaseCache {
+ public:
+  struct Policy {
+    // Time between background refreshes of each remote's database, 0 polls
+    // the database on every request instead
+    std::chrono::seconds refresh_interval{0};
+    // Maximum age of a background refreshed database before a request polls
+    // it itself, 0 for three refresh intervals
+    std::chrono::seconds max_staleness{0};
+    // Time between full polls, which drop the records deleted from the data
+    // service, 0 only polls the changes
+    std::chrono::seconds full_sync_interval{3600};
+  };
+  /**
+   * Fetches the remote's database with ids, or only the records changed
+   * since from_date
+   */
+  using Fetcher = std::function<ServerData(const RemoteId&,
+      std::optional<ToDate> from_date)>;
+  /**
+   * Loads the remote's snapshot, if any, and writes a new one
+   */
+  using SnapshotLoader = std::function<std::optional<ServerData>(
+      const RemoteId&)>;
+  using SnapshotSaver = std::function<void(const RemoteId&, const ServerData&)>;
+
+  /**
+   * The policy is queried on every use, so that it follows the current
+   * configuration
+   */
+  DatabaseCache(std::function<Policy()> policy, Fetcher fetch,
+      SnapshotLoader load_snapshot = nullptr,
+      SnapshotSaver save_snapshot = nullptr);
+  /**
+   * Stops and joins all refreshers
+   */
+  ~DatabaseCache();
+
+  std::shared_ptr<const ServerData> get_database(const RemoteId&) const;
+  /**
+   * Returns the background refreshed database of the remote if it is recent
+   * enough, otherwise polls it first. A poll that finishes while waiting for
+   * another one of the same remote is used as is.
+   */
+  std::shared_ptr<const ServerData> get_current_database(const RemoteId&);
+  /**
+   * Starts a thread refreshing the remote's database in the background, if
+   * configured and not yet running
+   */
+  void start_refresher(const RemoteId&);
+  size_t poll_database(const RemoteId&);
+  /**
+   * Only fetches the records that changed since the last poll and merges them
+   * into the cached database. Without cached database, resumes from the
+   * remote's snapshot, if any. Falls back to a full poll if there is no cached
+   * database yet or its last full poll is older than the full sync interval,
+   * as deleted records are not part of a diff.
+   */
+  size_t poll_database_diff(const RemoteId&);
+
+ private:
+  // Unserialized implementations of poll_database() and poll_database_diff()
+  size_t poll_full(const RemoteId&);
+  size_t poll_diff(const RemoteId&);
+  std::mutex& sync_mutex(const RemoteId&);
+  /**
+   * Whether the last full poll of the database is older than the full sync
+   * interval
+   */
+  bool full_sync_due(const ServerData&) const;
+  size_t store_database(const RemoteId&, ServerData&&,
+      const std::shared_ptr<const ServerData>& cached, bool changed);
+  void refresh_database(const RemoteId&, std::chrono::seconds interval);
+  /**
+   * Loads the remote's snapshot, if it is recent enough, and caches it unless
+   * another database was cached in the meantime
+   */
+  std::shared_ptr<const ServerData> load_snapshot(const RemoteId&);
+
+  std::function<Policy()> m_policy;
+  Fetcher m_fetch;
+  SnapshotLoader m_load_snapshot;
+  SnapshotSaver m_save_snapshot;
+  mutable std::mutex m_db_mutex;
+  std::map<RemoteId, std::shared_ptr<const ServerData>> m_databases;
+  // Serializes the polls of each remote
+  std::map<RemoteId, std::mutex> m_sync_mutexes;
+  std::map<RemoteId, std::thread> m_refreshers;
+  std::mutex m_refresh_mutex;
+  std::condition_variable m_refresh_cond;
+  bool m_stop_refreshing{false};
+};
+
+}  // namespace sel
+
+#endif /* end of include guard: SEL_DATABASECACHE_H */
@@ -22,9 +22,14 @@
 #include <curlpp/Infos.hpp>
 #include <curlpp/Options.hpp>
 #include <curlpp/cURLpp.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
 #include <map>
 #include <memory>
 #include <optional>
+#include <regex>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -40,11 +45,32 @@
 #include "restbed"
 #include "resttypes.h"
 #include "restutils.h"
-#include "jsonutils.h"
+#include "pageparser.h"
 #include "util.h"
 
 using namespace std;
 namespace sel {
+
+namespace {
+
+// Pages returning faster than half of this are dominated by the round trip,
+// pages slower than twice of it are split up
+constexpr chrono::milliseconds TargetPageTime{500};
+constexpr size_t MinPageSize{10}, MaxPageSize{10000};
+
+/**
+ * Replaces the page number in the URL of a page by the given one. Returns
+ * nullopt if the URL has no page parameter.
+ */
+optional<string> page_url(const string& url, unsigned page) {
+  const regex page_param{"([?&]page=)[0-9]+"};
+  if (!regex_search(url, page_param)) return nullopt;
+  return regex_replace(url, page_param, "$01" + to_string(page),
+      regex_constants::format_first_only);
+}
+
+} // namespace
+
 DatabaseFetcher::DatabaseFetcher(
     std::shared_ptr<const LocalConfiguration> local_conf,
     std::string url,
@@ -65,36 +91,48 @@ DatabaseFetcher::DatabaseFetcher(
       m_page_size(page_size),
       m_logger{get_logger()} {}
 
-ServerData DatabaseFetcher::fetch_data(bool matching_mode) {
-  m_logger->debug("Requesting Database from {}?pageSize={}\n", m_url,
-                  m_page_size);
-  m_logger->info("Requesting Database");
+ServerData DatabaseFetcher::fetch_data(bool matching_mode,
+    optional<ToDate> from_date) {
+  string query{"?pageSize=" + to_string(m_page_size)};
+  if (from_date) {
+    query += "&fromDate=" + to_string(*from_date);
+  }
+  m_logger->debug("Requesting Database from {}{}\n", m_url, query);
+  m_logger->info(from_date ? "Requesting Database changes" : "Requesting Database");
+  // Pages that lack them must not inherit the values of a previous fetch
   m_page = 1u;
-  auto paget{request_page(m_url + "?pageSize=" + to_string(m_page_size))};
-  auto page =
-      *(paget.begin());  // FIXME(TK): JSon wird zusätzlich in Array gepack
-  if (page.count("lastPageNumber")) {
-    m_last_page = page.at("lastPageNumber").get<unsigned>();
+  m_last_page = 1u;
+  m_todate = 0;
+  m_page_time = {};
+  const auto start{chrono::steady_clock::now()};
+  const auto body{request_page(m_url + query)};
+  m_page_time += chrono::steady_clock::now() - start;
+  // The first page comes wrapped in an array, which the parser unwraps
+  const auto page{parse_page(body, matching_mode, m_records, m_ids)};
+  if (page.last_page()) {
+    m_last_page = *page.last_page();
   }
-  if (page.count("toDate")) {
-    m_todate = page.at("toDate").get<size_t>();
+  if (page.todate()) {
+    m_todate = *page.todate();
   }
-  if (!page.count("remoteId")) {
+  if (!page.remote_id()) {
     throw runtime_error("Invalid JSON Data: missing remoteId");
   }
-  if (!page.count("localId")) {
+  if (!page.local_id()) {
     throw runtime_error("Invalid JSON Data: missing localId");
   }
-  m_remote_id = page["remoteId"].get<RemoteId>();
-  m_local_id = page["localId"].get<RemoteId>();
+  m_remote_id = *page.remote_id();
+  m_local_id = *page.local_id();
 
-  for (; m_page != m_last_page; ++m_page) {
-    save_page_data(page, matching_mode, true);
-    m_next_page = page.at("_links").at("next").at("href").get<string>();
-    page = get_next_page();
+  if (m_page < m_last_page) {
+    m_next_page = next_page_link(page);
+    for (auto& column : m_records) {
+      column.second.reserve(size_t{m_last_page} * m_page_size);
+    }
+    fetch_remaining_pages(matching_mode);
   }
-  // Process Data from last page
-  save_page_data(page, matching_mode, true);
+  adapt_page_size(chrono::duration_cast<chrono::milliseconds>(
+        m_page_time / max(m_last_page, 1u)));
 
 #ifdef DEBUG_SEL_REST
   string input_string;
@@ -102,11 +140,11 @@ ServerData DatabaseFetcher::fetch_data(bool matching_mode) {
     input_string += "-------------------------------\n" + p.first +
                     "\n-------------------------------"
                     "\n";
-    for (auto& d : p.second) {
-      bool empty{!d};
+    for (size_t i = 0; i != p.second.size(); ++i) {
+      bool empty{!p.second.has_value(i)};
       input_string += "Field "s + (empty ? "" : "not ") + "empty ";
       if (!empty) {
-        for (const auto& byte : d.value())
+        for (const auto& byte : p.second.entry(i).value())
           input_string += to_string(byte) + " ";
       }
       input_string += "\n";
@@ -129,31 +167,88 @@ ServerData DatabaseFetcher::fetch_data(bool matching_mode) {
   }
 }
 
-void DatabaseFetcher::save_page_data(const nlohmann::json& page_data, bool matching_mode, bool servermode) {
-    if(servermode){
-      if (!page_data.count("_links")) {
-        throw runtime_error("Invalid JSON Data: missing _links section");
-      }
-    }
-  if (!page_data.count("records")) {
+PageParser DatabaseFetcher::parse_page(const string& body, bool matching_mode,
+    VRecord& records, vector<string>& ids, size_t expected_records) const {
+  PageParser page{m_local_config->get_fields(), records,
+    matching_mode ? nullptr : &ids, expected_records};
+  page.parse(body);
+  if (!page.has_links()) {
+    throw runtime_error("Invalid JSON Data: missing _links section");
+  }
+  if (!page.has_records()) {
     throw runtime_error("Invalid JSON Data: missing records section");
   }
+  return page;
+}
+
+string DatabaseFetcher::next_page_link(const PageParser& page) {
+  if (!page.next_page()) {
+    throw runtime_error("Invalid JSON Data: missing next page link");
+  }
+  return *page.next_page();
+}
+
+void DatabaseFetcher::fetch_remaining_pages(bool matching_mode) {
+  // Pages can only be requested out of order if their number is in the URL
+  if (m_fetch_window < 2 || !page_url(m_next_page, m_page + 1)) {
+    for (++m_page; ; ++m_page) {
+      const auto start{chrono::steady_clock::now()};
+      const auto body{request_page(m_next_page)};
+      m_page_time += chrono::steady_clock::now() - start;
+      const auto page{parse_page(body, matching_mode, m_records, m_ids)};
+      if (m_page >= m_last_page) break;
+      m_next_page = next_page_link(page);
+    }
+    return;
+  }
+
+  struct PageData {
+    VRecord records;
+    vector<string> ids;
+    chrono::steady_clock::duration time;
+  };
+  // Downloads and parses a page on a worker thread
+  const auto fetch_page = [this, matching_mode](unsigned page_number) {
+    PageData data;
+    const auto start{chrono::steady_clock::now()};
+    const auto body{request_page(*page_url(m_next_page, page_number))};
+    data.time = chrono::steady_clock::now() - start;
+    parse_page(body, matching_mode, data.records, data.ids, m_page_size);
+    return data;
+  };
 
-  const auto& records_json = page_data["records"];
-  const auto& fields = m_local_config->get_fields();
-  auto temp_data = parse_json_fields_array(fields, records_json);
-  append_to_map_of_vectors(temp_data, m_records);
-  if(!matching_mode && servermode) {
-    auto temp_ids = parse_json_id_array(records_json);
-    m_ids.insert(m_ids.end(), temp_ids.begin(), temp_ids.end());
+  m_logger->debug("Fetching pages {} to {} with a window of {} pages",
+      m_page + 1, m_last_page, m_fetch_window);
+  // Pages are appended in order while the following ones are still fetched
+  deque<future<PageData>> window;
+  unsigned next_page{m_page + 1};
+  while (m_page < m_last_page) {
+    while (window.size() < m_fetch_window && next_page <= m_last_page) {
+      window.emplace_back(async(launch::async, fetch_page, next_page++));
+    }
+    auto data{window.front().get()};
+    window.pop_front();
+    append_columns(data.records, m_records);
+    m_ids.insert(m_ids.end(), data.ids.cbegin(), data.ids.cend());
+    m_page_time += data.time;
+    ++m_page;
   }
 }
 
-nlohmann::json DatabaseFetcher::get_next_page() const {
-  return request_page(m_next_page);
+void DatabaseFetcher::adapt_page_size(chrono::milliseconds mean_page_time) {
+  const auto old_size{m_page_size};
+  if (mean_page_time < TargetPageTime/2) {
+    m_page_size = min(2*m_page_size, MaxPageSize);
+  } else if (mean_page_time > 2*TargetPageTime) {
+    m_page_size = max(m_page_size/2, MinPageSize);
+  }
+  if (m_page_size != old_size) {
+    m_logger->debug("Pages took {}ms on average, adapting page size from {} "
+        "to {}", mean_page_time.count(), old_size, m_page_size);
+  }
 }
 
-nlohmann::json DatabaseFetcher::request_page(const string& url) const {
+string DatabaseFetcher::request_page(const string& url) const {
   list<string> headers;
   m_logger->debug("DB request address: {}", url);
   m_logger->debug("Auth Header for DB: {}", m_local_authenticator.sign_transaction(""));
@@ -165,15 +260,10 @@ nlohmann::json DatabaseFetcher::request_page(const string& url) const {
     } else {
       throw runtime_error("No valid data returned from Database");
     }
-    try {
-      return nlohmann::json::parse(response.body);
-    } catch (const exception& e) {
-      m_logger->error("Error parsing JSON from database: {}", e.what());
-      return nlohmann::json();
-    }
+    return move(response.body);
   } else {
     m_logger->error("Error getting data from data service: {} - {}", response.return_code, response.body);
-    return nlohmann::json();
+    throw runtime_error("Error getting data from data service");
   }
 }
 
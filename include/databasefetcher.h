@@ -19,12 +19,14 @@
 #ifndef SEL_DATABASEFETCHER_H
 #define SEL_DATABASEFETCHER_H
 
+#include <chrono>
 #include <map>
+#include <optional>
 #include <string>
 #include <vector>
 #include "datahandler.h"
 #include "epilink_input.h"
-#include "nlohmann/json.hpp"
+#include "pageparser.h"
 #include "resttypes.h"
 
 namespace spdlog {
@@ -37,7 +39,10 @@ class Authenticator;
 
 class DatabaseFetcher {
  public:
-  ServerData fetch_data(bool);
+  /**
+   * Fetches all records, or only those changed since from_date, if set
+   */
+  ServerData fetch_data(bool, std::optional<ToDate> from_date = std::nullopt);
   DatabaseFetcher(std::shared_ptr<const LocalConfiguration> local_conf,
                   std::string url,
                   Authenticator const& l_auth);
@@ -48,22 +53,40 @@ class DatabaseFetcher {
                   size_t page_size);
   void set_url(const std::string& url) { m_url = url; }
   void set_page_size(unsigned size) { m_page_size = size; }
+  /**
+   * Number of pages requested and parsed concurrently after the first page
+   */
+  void set_fetch_window(size_t window) { m_fetch_window = window; }
+  /**
+   * Page size adapted to the latency of the pages of the last fetch
+   */
+  size_t get_page_size() const { return m_page_size; }
   size_t get_todate() const { return m_todate; }
-  void save_page_data(const nlohmann::json&, bool, bool);
 
  private:
-  nlohmann::json get_next_page() const;
-  nlohmann::json request_page(const std::string& url) const;
+  /**
+   * Parses the records of a page into records and, if not matching_mode, their
+   * ids into ids. Returns the parser with the page's metadata.
+   */
+  PageParser parse_page(const std::string& body, bool matching_mode,
+      VRecord& records, std::vector<std::string>& ids,
+      size_t expected_records = 0) const;
+  static std::string next_page_link(const PageParser& page);
+  void fetch_remaining_pages(bool);
+  void adapt_page_size(std::chrono::milliseconds mean_page_time);
+  std::string request_page(const std::string& url) const;
   VRecord m_records;
   std::vector<std::string> m_ids;
   std::string m_next_page;
-  size_t m_todate;
+  size_t m_todate{0};
   RemoteId m_local_id;
   RemoteId m_remote_id;
   std::string m_url;
   std::shared_ptr<const LocalConfiguration> m_local_config;
   Authenticator const& m_local_authenticator;
-  unsigned m_page_size{25u};
+  size_t m_page_size{25u};
+  size_t m_fetch_window{1u};
+  std::chrono::steady_clock::duration m_page_time{0};
   unsigned m_last_page{1u};
   unsigned m_page{1u};
   std::shared_ptr<spdlog::logger> m_logger;
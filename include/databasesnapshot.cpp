@@ -0,0 +1,321 @@
+/**
+\file    databasesnapshot.cpp
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Binary snapshots of the database for fast restarts
+*/
+
+#include "databasesnapshot.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fmt/format.h"
+
+using namespace std;
+namespace sel {
+
+namespace {
+
+constexpr array<char, 8> SnapshotMagic{'S', 'E', 'L', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t SnapshotVersion{2};
+// Detects snapshots written on hosts of different byte order
+constexpr uint32_t ByteOrderMark{0x01020304};
+constexpr size_t Alignment{64};
+
+using HammingWeight = FieldColumn::HammingWeight;
+
+size_t padding(size_t offset) {
+  return (Alignment - offset % Alignment) % Alignment;
+}
+
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(const filesystem::path& file)
+      : m_file{file}, m_out{file, ios::binary | ios::trunc} {
+    if (!m_out) {
+      throw runtime_error(fmt::format("Cannot open database snapshot {} for "
+                                      "writing", m_file.string()));
+    }
+  }
+
+  void write_bytes(const void* data, size_t size) {
+    m_out.write(static_cast<const char*>(data), size);
+    m_offset += size;
+  }
+  template <class T>
+  void write(const T& value) {
+    write_bytes(&value, sizeof(T));
+  }
+  void write_string(const std::string& str) {
+    write<uint64_t>(str.size());
+    write_bytes(str.data(), str.size());
+  }
+  void align() {
+    static const array<char, Alignment> zeros{};
+    write_bytes(zeros.data(), padding(m_offset));
+  }
+
+  void close() {
+    m_out.close();
+    if (!m_out) {
+      throw runtime_error(fmt::format("Error writing database snapshot {}",
+                                      m_file.string()));
+    }
+  }
+
+ private:
+  filesystem::path m_file;
+  ofstream m_out;
+  size_t m_offset{0};
+};
+
+class SnapshotReader {
+ public:
+  SnapshotReader(const uint8_t* data, size_t size, const filesystem::path& file)
+      : m_data{data}, m_size{size}, m_file{file} {}
+
+  const uint8_t* take(size_t size) {
+    if (size > m_size - m_offset) {
+      throw runtime_error(fmt::format("Database snapshot {} is truncated",
+                                      m_file.string()));
+    }
+    const auto* data{m_data + m_offset};
+    m_offset += size;
+    return data;
+  }
+  template <class T>
+  T read() {
+    T value;
+    memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+  std::string read_string() {
+    const auto size{read<uint64_t>()};
+    const auto* data{take(size)};
+    return {reinterpret_cast<const char*>(data), size};
+  }
+  void align() { take(padding(m_offset)); }
+
+ private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_offset{0};
+  const filesystem::path& m_file;
+};
+
+/**
+ * Flushes the file or directory to disk
+ */
+void sync_path(const filesystem::path& path) {
+  const int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0 || fsync(fd)) {
+    const int sync_error{errno};
+    if (fd >= 0) ::close(fd);
+    throw runtime_error(fmt::format("Cannot sync {} to disk: {}",
+                                    path.string(), strerror(sync_error)));
+  }
+  ::close(fd);
+}
+
+/**
+ * Maps the whole file read-only, the mapping lives as long as the returned
+ * pointer
+ */
+shared_ptr<const void> map_file(const filesystem::path& file, size_t& size) {
+  const int fd{::open(file.c_str(), O_RDONLY)};
+  if (fd < 0) {
+    throw runtime_error(fmt::format("Cannot open database snapshot {}: {}",
+                                    file.string(), strerror(errno)));
+  }
+  struct stat status;
+  if (fstat(fd, &status) || !status.st_size) {
+    ::close(fd);
+    throw runtime_error(fmt::format("Database snapshot {} is empty",
+                                    file.string()));
+  }
+  size = status.st_size;
+  void* memory{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  const int map_error{errno};
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    throw runtime_error(fmt::format("Cannot map database snapshot {}: {}",
+                                    file.string(), strerror(map_error)));
+  }
+  // All of it is needed to build the circuits
+  madvise(memory, size, MADV_WILLNEED);
+  return {memory, [size](const void* memory) {
+            munmap(const_cast<void*>(memory), size);
+          }};
+}
+
+}  // namespace
+
+void write_database_snapshot(const ServerData& data,
+                             const map<FieldName, FieldSpec>& fields,
+                             const filesystem::path& file) {
+  const auto& records{*data.data};
+  const size_t num_records{records.empty() ? 0
+                                           : records.begin()->second.size()};
+  for (const auto& [name, column] : records) {
+    check_column_size(column, num_records, name);
+    if (!fields.count(name)) {
+      throw invalid_argument(fmt::format("Database field {} is not "
+                                         "configured", name));
+    }
+  }
+  if (data.ids && data.ids->size() != num_records) {
+    throw invalid_argument(fmt::format("Database has {} records but {} ids",
+                                       num_records, data.ids->size()));
+  }
+
+  auto tmp_file{file};
+  tmp_file += ".tmp";
+  SnapshotWriter out{tmp_file};
+  out.write_bytes(SnapshotMagic.data(), SnapshotMagic.size());
+  out.write(SnapshotVersion);
+  out.write(ByteOrderMark);
+  out.write<uint64_t>(data.todate);
+  out.write<int64_t>(chrono::duration_cast<chrono::seconds>(
+      data.full_sync_time.time_since_epoch()).count());
+  out.write<uint64_t>(num_records);
+  out.write<uint64_t>(records.size());
+  out.write<uint64_t>(data.ids != nullptr);
+  out.write_string(data.local_id);
+  out.write_string(data.remote_id);
+  for (const auto& [name, column] : records) {
+    out.write_string(name);
+    out.write<uint64_t>(column.bitsize());
+    const auto& field{fields.at(name)};
+    out.write<uint32_t>(static_cast<uint32_t>(field.type));
+    out.write<uint32_t>(static_cast<uint32_t>(field.comparator));
+  }
+
+  for (const auto& column : records) {
+    const auto& col{column.second};
+    out.align();
+    out.write_bytes(col.data(), num_records * col.bytesize());
+    // Slices don't start at a bitmap word, so the bitmap is rebuilt
+    vector<uint64_t> validity((num_records + 63) / 64, 0);
+    for (size_t i = 0; i != num_records; ++i) {
+      if (col.has_value(i)) validity[i / 64] |= 1ULL << (i % 64);
+    }
+    out.align();
+    out.write_bytes(validity.data(), validity.size() * sizeof(uint64_t));
+    out.align();
+    out.write_bytes(col.hws(), num_records * sizeof(HammingWeight));
+  }
+  if (data.ids) {
+    for (const auto& id : *data.ids) out.write_string(id);
+  }
+  out.close();
+  sync_path(tmp_file);
+  filesystem::rename(tmp_file, file);
+  sync_path(file.has_parent_path() ? file.parent_path() : ".");
+}
+
+ServerData map_database_snapshot(const filesystem::path& file,
+                                 const map<FieldName, FieldSpec>& fields) {
+  size_t size;
+  const auto memory{map_file(file, size)};
+  SnapshotReader in{static_cast<const uint8_t*>(memory.get()), size, file};
+  const auto* magic{in.take(SnapshotMagic.size())};
+  if (!equal(SnapshotMagic.cbegin(), SnapshotMagic.cend(), magic)) {
+    throw runtime_error(fmt::format("{} is no database snapshot",
+                                    file.string()));
+  }
+  if (in.read<uint32_t>() != SnapshotVersion ||
+      in.read<uint32_t>() != ByteOrderMark) {
+    throw runtime_error(fmt::format("Database snapshot {} has an incompatible "
+                                    "format", file.string()));
+  }
+
+  ServerData data;
+  data.todate = in.read<uint64_t>();
+  data.full_sync_time = chrono::system_clock::time_point{
+    chrono::seconds{in.read<int64_t>()}};
+  const auto num_records{in.read<uint64_t>()};
+  // Each record takes at least a hamming weight, so that no size computed
+  // from num_records can overflow
+  if (num_records > size / sizeof(HammingWeight)) {
+    throw runtime_error(fmt::format("Database snapshot {} is truncated",
+                                    file.string()));
+  }
+  const auto num_fields{in.read<uint64_t>()};
+  const bool has_ids{in.read<uint64_t>() != 0};
+  data.local_id = in.read_string();
+  data.remote_id = in.read_string();
+  if (num_fields != fields.size()) {
+    throw runtime_error(fmt::format("Database snapshot {} has {} fields, but "
+                                    "{} are configured", file.string(),
+                                    num_fields, fields.size()));
+  }
+  vector<pair<FieldName, size_t>> schema;
+  schema.reserve(num_fields);
+  for (size_t i = 0; i != num_fields; ++i) {
+    auto name{in.read_string()};
+    const auto bitsize{in.read<uint64_t>()};
+    const auto type{in.read<uint32_t>()};
+    const auto comparator{in.read<uint32_t>()};
+    // Values encoded for another type or comparator are useless
+    const auto field{fields.find(name)};
+    if (field == fields.end() || field->second.bitsize != bitsize ||
+        static_cast<uint32_t>(field->second.type) != type ||
+        static_cast<uint32_t>(field->second.comparator) != comparator) {
+      throw runtime_error(fmt::format("Field {} of database snapshot {} "
+                                      "differs from the configuration", name,
+                                      file.string()));
+    }
+    // Would leave a configured field without column
+    if (any_of(schema.cbegin(), schema.cend(),
+          [&name](const auto& column) { return column.first == name; })) {
+      throw runtime_error(fmt::format("Field {} appears twice in database "
+                                      "snapshot {}", name, file.string()));
+    }
+    schema.emplace_back(move(name), bitsize);
+  }
+
+  data.data = make_shared<VRecord>();
+  for (const auto& [name, bitsize] : schema) {
+    in.align();
+    const auto* values{in.take(num_records * bitbytes(bitsize))};
+    in.align();
+    const auto* validity{reinterpret_cast<const uint64_t*>(
+        in.take((num_records + 63) / 64 * sizeof(uint64_t)))};
+    in.align();
+    const auto* hws{reinterpret_cast<const HammingWeight*>(
+        in.take(num_records * sizeof(HammingWeight)))};
+    data.data->emplace(name, FieldColumn{bitsize, num_records, memory, values,
+                                         validity, hws});
+  }
+  if (has_ids) {
+    auto ids{make_shared<vector<std::string>>()};
+    ids->reserve(num_records);
+    for (size_t i = 0; i != num_records; ++i) {
+      ids->emplace_back(in.read_string());
+    }
+    data.ids = move(ids);
+  }
+  data.fetch_time = {};
+  return data;
+}
+
+}  // namespace sel
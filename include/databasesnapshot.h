@@ -0,0 +1,60 @@
+/**
+\file    databasesnapshot.h
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Binary snapshots of the database for fast restarts
+*/
+
+#ifndef SEL_DATABASESNAPSHOT_H
+#define SEL_DATABASESNAPSHOT_H
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include "seltypes.h"
+#include "serverdata.h"
+
+namespace sel {
+
+/**
+ * Writes the database to a snapshot file. The header holds the toDate, the
+ * time of the last full sync, the ids of both parties and the field schema
+ * with the name, bitsize, type and comparator from fields of each column.
+ * It is followed by the packed values, validity bitmap and hamming weights
+ * of each column, cache line aligned, and the record ids. Integers are
+ * stored in host byte order.
+ *
+ * The snapshot is written to a temporary file first, synced to disk and
+ * renamed, so that a crash never leaves a partial snapshot and mapped old
+ * snapshots stay valid.
+ */
+void write_database_snapshot(const ServerData& data,
+                             const std::map<FieldName, FieldSpec>& fields,
+                             const std::filesystem::path& file);
+
+/**
+ * Maps the snapshot file into memory. The columns of the returned database
+ * read directly from the mapping, only the ids are copied. Its fetch time is
+ * unset, so that it counts as stale.
+ *
+ * Throws runtime_error if the file is no valid snapshot, holds a field twice
+ * or the name, bitsize, type or comparator of its fields differ from the
+ * given ones.
+ */
+ServerData map_database_snapshot(const std::filesystem::path& file,
+                                 const std::map<FieldName, FieldSpec>& fields);
+
+}  // namespace sel
+
+#endif /* end of include guard: SEL_DATABASESNAPSHOT_H */
@@ -1,9 +1,12 @@
 #include "datahandler.h"
 #include "configurationhandler.h"
 #include "databasefetcher.h"
+#include "databasesnapshot.h"
 #include "localconfiguration.h"
 #include "remoteconfiguration.h"
 #include "clear_epilinker.h"
+#include "logger.h"
+#include <filesystem>
 #include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
@@ -40,28 +43,104 @@ void Debugger::reset() {
     return cref(get());
   }
 
-size_t DataHandler::poll_database(const RemoteId& remote_id, bool counting_mode) {
+namespace {
+
+DatabaseFetcher make_database_fetcher(const RemoteId& remote_id,
+    size_t page_size) {
   const auto& config_handler{ConfigurationHandler::cget()};
   const auto local_configuration{config_handler.get_local_config()};
-  DatabaseFetcher database_fetcher{
-      local_configuration,
+  DatabaseFetcher database_fetcher{local_configuration,
       local_configuration->get_data_service()+"/"+remote_id,
-      local_configuration->get_local_authenticator(),
-      config_handler.get_server_config().default_page_size};
-  auto data{database_fetcher.fetch_data(counting_mode)};
-  lock_guard<mutex> lock(m_db_mutex);
-  m_database = make_shared<const ServerData>(move(data));
-  return (m_database->data->begin()->second.size());
+      local_configuration->get_local_authenticator(), page_size};
+  database_fetcher.set_fetch_window(
+      config_handler.get_server_config().database_fetch_window);
+  return database_fetcher;
+}
+
+DatabaseCache::Policy make_cache_policy() {
+  const auto& server_config{ConfigurationHandler::cget().get_server_config()};
+  return {chrono::seconds{server_config.database_refresh_interval},
+    chrono::seconds{server_config.database_max_staleness},
+    chrono::seconds{server_config.database_full_sync_interval}};
+}
+
+filesystem::path snapshot_file(const RemoteId& remote_id) {
+  const auto directory{ConfigurationHandler::cget().get_server_config()
+    .database_snapshot_directory};
+  return directory.empty() ? directory : directory / (remote_id + ".snapshot");
+}
+
+} // namespace
+
+DataHandler::DataHandler()
+    : m_databases{make_cache_policy,
+        [this](const RemoteId& remote_id, optional<ToDate> from_date) {
+          return fetch_database(remote_id, from_date);
+        },
+        [this](const RemoteId& remote_id) { return load_snapshot(remote_id); },
+        [this](const RemoteId& remote_id, const ServerData& data) {
+          save_snapshot(remote_id, data);
+        }} {}
+
+ServerData DataHandler::fetch_database(const RemoteId& remote_id,
+    optional<ToDate> from_date) {
+  size_t page_size{
+    ConfigurationHandler::cget().get_server_config().default_page_size};
+  {
+    lock_guard<mutex> lock(m_page_size_mutex);
+    if (const auto it{m_page_sizes.find(remote_id)}; it != m_page_sizes.end()) {
+      page_size = it->second;
+    }
+  }
+  auto database_fetcher{make_database_fetcher(remote_id, page_size)};
+  // All jobs share the cached database, so the ids are always fetched
+  auto data{database_fetcher.fetch_data(false, from_date)};
+  lock_guard<mutex> lock(m_page_size_mutex);
+  m_page_sizes[remote_id] = database_fetcher.get_page_size();
+  return data;
+}
+
+optional<ServerData> DataHandler::load_snapshot(
+    const RemoteId& remote_id) const {
+  const auto file{snapshot_file(remote_id)};
+  if (file.empty() || !filesystem::exists(file)) return nullopt;
+  try {
+    const auto local_config{ConfigurationHandler::cget().get_local_config()};
+    return map_database_snapshot(file, local_config->get_fields());
+  } catch (const exception& e) {
+    get_logger(ComponentLogger::REST)->warn("Ignoring database snapshot of "
+        "remote {}: {}", remote_id, e.what());
+    return nullopt;
+  }
+}
+
+void DataHandler::save_snapshot(const RemoteId& remote_id,
+    const ServerData& data) const {
+  const auto file{snapshot_file(remote_id)};
+  if (file.empty()) return;
+  try {
+    filesystem::create_directories(file.parent_path());
+    const auto local_config{ConfigurationHandler::cget().get_local_config()};
+    write_database_snapshot(data, local_config->get_fields(), file);
+    get_logger(ComponentLogger::REST)->debug("Wrote database snapshot of "
+        "remote {} to {}", remote_id, file.string());
+  } catch (const exception& e) {
+    get_logger(ComponentLogger::REST)->error("Error writing database snapshot "
+        "of remote {}: {}", remote_id, e.what());
+  }
+}
+
+shared_ptr<const ServerData> DataHandler::get_current_database(
+    const RemoteId& remote_id) {
+  return m_databases.get_current_database(remote_id);
 }
 
-size_t DataHandler:: poll_database_diff() {
-  // TODO(TK): Implement
-  //return poll_database();
-  return 0;
+void DataHandler::start_refresher(const RemoteId& remote_id) {
+  m_databases.start_refresher(remote_id);
 }
 
-std::shared_ptr<const ServerData> DataHandler::get_database() const{
-  lock_guard<mutex> lock(m_db_mutex);
-  return m_database;
+std::shared_ptr<const ServerData> DataHandler::get_database(
+    const RemoteId& remote_id) const {
+  return m_databases.get_database(remote_id);
 }
 }  // namespace sel
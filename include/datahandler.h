@@ -22,9 +22,12 @@
 
 #include "resttypes.h"
 #include "epilink_input.h"
+#include "serverdata.h"
+#include "databasecache.h"
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -39,14 +42,6 @@ namespace sel {
 class ConfigurationHandler;
 class DatabaseFetcher;
 
-struct ServerData {
-  std::shared_ptr<VRecord> data;
-  std::shared_ptr<std::vector<std::string>> ids;
-  ToDate todate;
-  RemoteId local_id;
-  RemoteId remote_id;
-};
-
 #ifdef DEBUG_SEL_REST
 struct Debugger{
   std::optional<Records> client_input;
@@ -63,20 +58,40 @@ struct Debugger{
 #endif
 
 class DataHandler {
-  DataHandler() = default;
+  DataHandler();
  public:
   static DataHandler& get();
   static DataHandler const& cget();
-  std::shared_ptr<const ServerData> get_database() const;
-  size_t poll_database(const RemoteId&, bool);
-  size_t poll_database_diff();  // TODO(TK) Not implemented yet. Use full update
+  std::shared_ptr<const ServerData> get_database(const RemoteId&) const;
+  /**
+   * Returns the current database of the remote, see
+   * DatabaseCache::get_current_database()
+   */
+  std::shared_ptr<const ServerData> get_current_database(const RemoteId&);
+  /**
+   * Starts a thread refreshing the remote's database in the background, if
+   * configured and not yet running
+   */
+  void start_refresher(const RemoteId&);
 #ifdef DEBUG_SEL_REST
   Debugger* get_epilink_debug() { return m_epilink_debug;}
 #endif
  private:
-  mutable std::mutex m_db_mutex;
-  std::shared_ptr<const ServerData> m_database;
+  /**
+   * Fetches the remote's database with the page size adapted by its last
+   * fetch
+   */
+  ServerData fetch_database(const RemoteId&,
+      std::optional<ToDate> from_date = std::nullopt);
+  /**
+   * Maps the remote's database snapshot, if configured and valid
+   */
+  std::optional<ServerData> load_snapshot(const RemoteId&) const;
+  void save_snapshot(const RemoteId&, const ServerData&) const;
+  std::mutex m_page_size_mutex;
+  std::map<RemoteId, size_t> m_page_sizes;
   std::unique_ptr<DatabaseFetcher> m_database_fetcher;
+  DatabaseCache m_databases;
 #ifdef DEBUG_SEL_REST
   Debugger* m_epilink_debug{new Debugger};
 #endif
@@ -83,6 +83,28 @@ EpilinkConfig::EpilinkConfig(
       logger->warn("String field '{}' has bitsize not divisible by 8.");
     }
   }
+
+  // Compile schema
+  field_specs = map_values(fields);
+  exchange_group_ids = transform_vec(exchange_groups,
+      [this](const IndexSet& group) {
+        vector<FieldId> ids;
+        ids.reserve(group.size());
+        // IndexSet is ordered, so are the ids
+        for (const auto& fname : group) ids.emplace_back(field_id(fname));
+        return ids;
+      });
+  for (FieldId id = 0; id != nfields; ++id) {
+    if (!xgunion.count(field_specs[id].name)) single_field_ids.emplace_back(id);
+  }
+}
+
+FieldId EpilinkConfig::field_id(const FieldName& name) const {
+  const auto it = fields.find(name);
+  if (it == fields.cend()) {
+    throw out_of_range(format("Field '{}' doesn't exist!", name));
+  }
+  return distance(fields.cbegin(), it);
 }
 
 EpilinkClientInput::EpilinkClientInput(unique_ptr<Records>&& records_, size_t database_size_) :
@@ -110,10 +132,33 @@ void EpilinkClientInput::check_keys() {
 
 void EpilinkServerInput::check_sizes() {
   for (const auto& row : *database) {
-    check_vector_size(row.second, database_size, "database field "s + row.first);
+    check_column_size(row.second, database_size, "database field "s + row.first);
+    if (prepared && prepared->deltas.at(row.first).size()
+        < prepared_offset + database_size) {
+      throw invalid_argument(format("EpilinkServerInput: prepared database "
+            "field {} is too small for offset {} and size {}.", row.first,
+            prepared_offset, database_size));
+    }
+  }
+}
+
+PreparedDatabase::PreparedDatabase(const VRecord& database, size_t version_) :
+  version{version_}
+{
+  for (const auto& [name, column] : database) {
+    auto& delta = deltas[name];
+    delta.resize(column.size());
+    for (size_t i = 0; i != column.size(); ++i) delta[i] = column.has_value(i);
   }
 }
 
+VRecord& append_columns(const VRecord& source, VRecord& destination) {
+  for (const auto& [name, column] : source) {
+    destination[name].append(column);
+  }
+  return destination;
+}
+
 EpilinkServerInput::EpilinkServerInput(shared_ptr<VRecord> database_, size_t num_records_) :
   database(move(database_)),
   database_size {database->cbegin()->second.size()},
@@ -126,6 +171,16 @@ EpilinkServerInput::EpilinkServerInput(const VRecord& database_, size_t num_reco
   num_records {num_records_}
 { check_sizes(); }
 
+EpilinkServerInput::EpilinkServerInput(shared_ptr<VRecord> database_,
+    shared_ptr<const PreparedDatabase> prepared_, size_t num_records_,
+    size_t prepared_offset_) :
+  database(move(database_)),
+  prepared(move(prepared_)),
+  prepared_offset {prepared_offset_},
+  database_size {database->cbegin()->second.size()},
+  num_records {num_records_}
+{ check_sizes(); }
+
 } // namespace sel
 
 std::ostream& operator<<(std::ostream& os,
@@ -147,7 +202,11 @@ std::ostream& operator<<(std::ostream& os, const sel::EpilinkClientInput& in) {
   os << "----- Client Input -----\n";
   const auto& records = *(in.records);
   for (size_t i = 0; i != records.size(); ++i) {
-    os << '[' << i << "] " << records[i];
+    // The map printer of util.h cannot see the FieldEntry printer declared
+    // after it
+    os << '[' << i << "] {";
+    for (const auto& field : records[i]) os << field << ", ";
+    os << '}';
   }
   os << "Number of records to link: " << in.num_records << '\n';
   return os << "Number of database records: " << in.database_size;
@@ -23,6 +23,7 @@
 #include "seltypes.h"
 #include "fmt/ostream.h"
 #include "util.h"
+#include "field_column.h"
 #include <vector>
 #include <map>
 #include <cstdint>
@@ -36,11 +37,17 @@ using Bitmask = std::vector<BitmaskUnit>;
 using VBitmask = std::vector<Bitmask>;
 // How we save all input data
 using FieldEntry = std::optional<Bitmask>;
-using VFieldEntry = std::vector<FieldEntry>;
 using Record = std::map<FieldName, FieldEntry>;
-using VRecord = std::map<FieldName, VFieldEntry>;
+// Database by field names, see FieldColumn
+using VRecord = std::map<FieldName, FieldColumn>;
 using Records = std::vector<Record>;
 
+/**
+ * Appends the columns of source to the columns of the same fields in
+ * destination
+ */
+VRecord& append_columns(const VRecord& source, VRecord& destination);
+
 struct EpilinkConfig {
   // field descriptions
   std::map<FieldName, FieldSpec> fields;
@@ -56,6 +63,18 @@ struct EpilinkConfig {
   size_t nfields; // total number of field
   Weight max_weight; // maximum weight for rescaling of weights
 
+  // Compiled field schema: Fields get dense ids in the order of their names,
+  // so that the circuit and the cleartext linkage can use flat vectors
+  // instead of maps keyed by field names.
+  std::vector<FieldSpec> field_specs; // by FieldId
+  std::vector<std::vector<FieldId>> exchange_group_ids; // each sorted
+  std::vector<FieldId> single_field_ids; // fields in no exchange group
+
+  /**
+   * Id of the given field. Throws out_of_range if it doesn't exist.
+   */
+  FieldId field_id(const FieldName& name) const;
+
   EpilinkConfig(
       std::map<FieldName, FieldSpec> fields,
       std::vector<IndexSet> exchange_groups,
@@ -87,10 +106,27 @@ private:
   void check_keys(); // called by public constructors to check that keys match
 };
 
+/**
+ * Server database preprocessed for ABY's input gates, built once per database
+ * version and shared by all linkage jobs against it. Packed values and hamming
+ * weights are read from the columns directly, only the delta flags need to be
+ * expanded into full circuit words for arithmetic input gates.
+ */
+struct PreparedDatabase {
+  size_t version;
+  // 1 if non-empty, 0 o/w, by field name
+  std::map<FieldName, std::vector<uint64_t>> deltas;
+
+  PreparedDatabase(const VRecord& database, size_t version);
+};
+
 struct EpilinkServerInput {
-  // Outer vector by fields, inner by records!
+  // Columns by fields, rows by records!
   // Need to model like this for ABY SIMD layout
   std::shared_ptr<VRecord> database;
+  // Optional preprocessed database, of which this input starts at offset
+  std::shared_ptr<const PreparedDatabase> prepared;
+  size_t prepared_offset{0};
 
   size_t database_size; // calculated
   // need to know number of remote client records when building circuit
@@ -98,6 +134,9 @@ struct EpilinkServerInput {
 
   EpilinkServerInput(std::shared_ptr<VRecord> database, size_t num_records);
   EpilinkServerInput(const VRecord& database, size_t num_records);
+  EpilinkServerInput(std::shared_ptr<VRecord> database,
+      std::shared_ptr<const PreparedDatabase> prepared, size_t num_records,
+      size_t prepared_offset = 0);
   EpilinkServerInput(const EpilinkServerInput&) = default;
   EpilinkServerInput(EpilinkServerInput&&) = default;
   EpilinkServerInput& operator=(const EpilinkServerInput&) = default;
@@ -126,7 +165,7 @@ struct formatter<sel::EpilinkConfig> {
   template <typename FormatContext>
   auto format(const sel::EpilinkConfig& conf, FormatContext &ctx) {
     const auto field_names = map_keys(conf.fields);
-    return format_to(ctx.begin(),
+    return format_to(ctx.out(),
         "EpilinkConfig{{thresholds={};{}, nfields={}, fields={}}}",
         conf.threshold, conf.tthreshold, conf.nfields, field_names
     );
@@ -58,7 +58,7 @@ struct formatter<sel::Result<T>> {
   auto format(const sel::Result<T>& r, FormatContext &ctx) {
     std::string type_spec;
     if constexpr (std::is_integral_v<T>) type_spec = ":x";
-    return format_to(ctx.begin(),
+    return format_to(ctx.out(),
         "best index: {}; match(/tent.)? {}/{}; "
         "num: {" + type_spec + "}; den: {" + type_spec + "}; score: {}"
         , (uint64_t)r.index, r.match, r.tmatch
@@ -75,7 +75,7 @@ struct formatter<sel::CountResult<T>> {
 
   template <typename FormatContext>
   auto format(const sel::CountResult<T>& r, FormatContext &ctx) {
-    return format_to(ctx.begin(), "matches/tent.: {}/{}", r.matches, r.tmatches);
+    return format_to(ctx.out(), "matches/tent.: {}/{}", r.matches, r.tmatches);
   }
 };
 
@@ -0,0 +1,210 @@
+/**
+ \file    field_column.cpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Columnar, bit-packed storage of a database field
+*/
+
+#include "field_column.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "fmt/format.h"
+
+using namespace std;
+
+namespace sel {
+
+FieldColumn::FieldColumn(size_t bitsize) :
+  bitsize_{bitsize}, buffers{make_shared<Buffers>()}
+{
+  if (bitsize > numeric_limits<HammingWeight>::max()) {
+    throw invalid_argument(fmt::format("Field bitsize {} too large for a "
+          "FieldColumn.", bitsize));
+  }
+}
+
+FieldColumn::FieldColumn(size_t bitsize,
+    const vector<optional<Bitmask>>& entries) :
+  FieldColumn{bitsize}
+{
+  reserve(entries.size());
+  for (const auto& e : entries) push_back(e);
+}
+
+FieldColumn::FieldColumn(size_t bitsize, size_t size,
+    shared_ptr<const void> memory, const uint8_t* values,
+    const uint64_t* validity, const HammingWeight* hws) :
+  FieldColumn{bitsize}
+{
+  size_ = size;
+  buffers->memory = move(memory);
+  buffers->external_values = values;
+  buffers->external_validity = validity;
+  buffers->external_hws = hws;
+}
+
+bool FieldColumn::has_value(size_t i) const {
+  const size_t j = offset + i;
+  return (buffers->validity_data()[j/64] >> (j%64)) & 1;
+}
+
+optional<Bitmask> FieldColumn::entry(size_t i) const {
+  if (!has_value(i)) return nullopt;
+  return Bitmask(value(i), value(i) + bytesize());
+}
+
+const uint8_t* FieldColumn::data() const {
+  return buffers ? buffers->values_data() + offset * bytesize() : nullptr;
+}
+
+const FieldColumn::HammingWeight* FieldColumn::hws() const {
+  return buffers ? buffers->hws_data() + offset : nullptr;
+}
+
+void FieldColumn::reserve(size_t n) {
+  detach();
+  buffers->values.reserve(n * bytesize());
+  buffers->validity.reserve((n + 63)/64);
+  buffers->hws.reserve(n);
+}
+
+void FieldColumn::push_back(const optional<Bitmask>& entry) {
+  if (entry) {
+    push_back(*entry);
+    return;
+  }
+  detach();
+  auto& b = *buffers;
+  if ((size_ % 64) == 0) b.validity.emplace_back(0);
+  b.values.resize(b.values.size() + bytesize(), 0);
+  b.hws.emplace_back(0);
+  ++size_;
+}
+
+void FieldColumn::push_back(const Bitmask& entry) {
+  check_entry_size(entry);
+  detach();
+  auto& b = *buffers;
+  if ((size_ % 64) == 0) b.validity.emplace_back(0);
+  b.values.insert(b.values.end(), entry.cbegin(), entry.cend());
+  b.hws.emplace_back(sel::hw(entry));
+  set_valid(size_);
+  ++size_;
+}
+
+void FieldColumn::append(const FieldColumn& other) {
+  if (!bitsize_ && empty()) bitsize_ = other.bitsize_;
+  if (other.bitsize_ != bitsize_) {
+    throw invalid_argument(fmt::format("Cannot append FieldColumn of bitsize "
+          "{} to one of bitsize {}.", other.bitsize_, bitsize_));
+  }
+  // other may share our buffers, which we are about to change
+  const FieldColumn source{other};
+  reserve(size_ + source.size_);
+  auto& b = *buffers;
+  b.values.insert(b.values.end(), source.data(),
+      source.data() + source.size_ * bytesize());
+  b.hws.insert(b.hws.end(), source.hws(), source.hws() + source.size_);
+  for (size_t i = 0; i != source.size_; ++i, ++size_) {
+    if ((size_ % 64) == 0) b.validity.emplace_back(0);
+    if (source.has_value(i)) set_valid(size_);
+  }
+}
+
+void FieldColumn::set(size_t i, const optional<Bitmask>& entry) {
+  if (i >= size_) {
+    throw out_of_range(fmt::format("Index {} exceeds FieldColumn of size {}.",
+          i, size_));
+  }
+  if (entry) check_entry_size(*entry);
+  detach();
+  auto& b = *buffers;
+  const auto dest = b.values.begin() + i * bytesize();
+  if (entry) {
+    copy(entry->cbegin(), entry->cend(), dest);
+    b.hws[i] = sel::hw(*entry);
+  } else {
+    fill(dest, dest + bytesize(), 0);
+    b.hws[i] = 0;
+  }
+  set_valid(i, entry.has_value());
+}
+
+FieldColumn FieldColumn::slice(size_t offset_, size_t length) const {
+  if (offset_ + length > size_) {
+    throw out_of_range(fmt::format("Slice [{}, {}) exceeds FieldColumn of "
+          "size {}.", offset_, offset_ + length, size_));
+  }
+  FieldColumn s{*this};
+  s.offset += offset_;
+  s.size_ = length;
+  return s;
+}
+
+void FieldColumn::detach() {
+  if (!buffers) {
+    buffers = make_shared<Buffers>();
+    return;
+  }
+  if (buffers.use_count() == 1 && !buffers->memory && offset == 0
+      && buffers->hws.size() == size_) {
+    return;
+  }
+
+  auto own = make_shared<Buffers>();
+  own->values.assign(data(), data() + size_ * bytesize());
+  own->hws.assign(hws(), hws() + size_);
+  own->validity.assign((size_ + 63)/64, 0);
+  for (size_t i = 0; i != size_; ++i) {
+    if (has_value(i)) own->validity[i/64] |= 1ULL << (i%64);
+  }
+  buffers = move(own);
+  offset = 0;
+}
+
+void FieldColumn::set_valid(size_t i, bool valid) {
+  if (valid) buffers->validity[i/64] |= 1ULL << (i%64);
+  else buffers->validity[i/64] &= ~(1ULL << (i%64));
+}
+
+void FieldColumn::check_entry_size(const Bitmask& entry) const {
+  if (entry.size() != bytesize()) {
+    throw invalid_argument(fmt::format("FieldColumn entry has {} bytes, "
+          "expected {}.", entry.size(), bytesize()));
+  }
+}
+
+bool operator==(const FieldColumn& a, const FieldColumn& b) {
+  if (a.bitsize() != b.bitsize() || a.size() != b.size()) return false;
+  // Empty entries are zero, so comparing the packed values compares the
+  // entries, up to the empty ones
+  if (!equal(a.data(), a.data() + a.size() * a.bytesize(), b.data())) {
+    return false;
+  }
+  for (size_t i = 0; i != a.size(); ++i) {
+    if (a.has_value(i) != b.has_value(i)) return false;
+  }
+  return true;
+}
+
+void check_column_size(const FieldColumn& column, size_t size,
+    const string& name) {
+  if (column.size() != size)
+    throw invalid_argument{fmt::format(
+        "check_column_size: size mismatch: all {} columns need to be of same "
+        "size {}. Found size {}", name, size, column.size())};
+}
+
+} // namespace sel
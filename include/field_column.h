@@ -0,0 +1,178 @@
+/**
+ \file    field_column.h
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Columnar, bit-packed storage of a database field
+*/
+
+#ifndef SEL_FIELD_COLUMN_H
+#define SEL_FIELD_COLUMN_H
+#pragma once
+
+#include "util.h"
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sel {
+
+/**
+ * Allocator of cache line aligned memory
+ */
+template <class T>
+struct CacheAlignedAllocator {
+  using value_type = T;
+  static constexpr std::align_val_t Alignment{64};
+
+  CacheAlignedAllocator() = default;
+  template <class U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), Alignment));
+  }
+  void deallocate(T* p, size_t) noexcept { ::operator delete(p, Alignment); }
+
+  template <class U>
+  bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+  template <class U>
+  bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+/**
+ * All entries of a single database field in columnar layout.
+ * Values are bit-packed into one contiguous, cache line aligned buffer of
+ * bytesize() bytes per entry, which is the layout of ABY's SIMD input gates.
+ * Empty entries are zero and marked in a validity bitmap. Hamming weights are
+ * precomputed on insertion.
+ *
+ * Slices share the buffers of the column they were taken from, so that
+ * database chunks don't need to be copied. Buffers are copied on write.
+ * Columns can also read from external, read-only memory, like a mapped
+ * database snapshot, which is copied on the first write as well.
+ */
+class FieldColumn {
+public:
+  using HammingWeight = uint16_t;
+
+  FieldColumn() = default;
+  explicit FieldColumn(size_t bitsize);
+  FieldColumn(size_t bitsize, const std::vector<std::optional<Bitmask>>& entries);
+  /**
+   * Column of size entries reading from the given buffers, which are kept
+   * alive by memory. validity holds (size + 63)/64 bitmap words.
+   */
+  FieldColumn(size_t bitsize, size_t size, std::shared_ptr<const void> memory,
+      const uint8_t* values, const uint64_t* validity,
+      const HammingWeight* hws);
+
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+  size_t bitsize() const { return bitsize_; }
+  size_t bytesize() const { return bitbytes(bitsize_); }
+
+  bool has_value(size_t i) const;
+  /**
+   * The bytesize() bytes of entry i, all zero if it is empty
+   */
+  const uint8_t* value(size_t i) const { return data() + i * bytesize(); }
+  HammingWeight hw(size_t i) const { return hws()[i]; }
+  /**
+   * Copy of entry i as a bitmask, nullopt if it is empty
+   */
+  std::optional<Bitmask> entry(size_t i) const;
+  std::optional<Bitmask> operator[](size_t i) const { return entry(i); }
+
+  /**
+   * Packed values and hamming weights of all entries
+   */
+  const uint8_t* data() const;
+  const HammingWeight* hws() const;
+
+  void reserve(size_t n);
+  /**
+   * Appends the entry, whose bitmask must be bytesize() bytes long
+   */
+  void push_back(const std::optional<Bitmask>& entry);
+  void push_back(const Bitmask& entry);
+  /**
+   * Appends all entries of other, which must have the same bitsize. Empty
+   * columns without bitsize take the bitsize of other.
+   */
+  void append(const FieldColumn& other);
+  /**
+   * Replaces entry i, whose bitmask must be bytesize() bytes long
+   */
+  void set(size_t i, const std::optional<Bitmask>& entry);
+
+  /**
+   * Entries [offset, offset+length) of this column, sharing its buffers
+   */
+  FieldColumn slice(size_t offset, size_t length) const;
+
+private:
+  struct Buffers {
+    std::vector<uint8_t, CacheAlignedAllocator<uint8_t>> values;
+    std::vector<uint64_t> validity; // bitmap
+    std::vector<HammingWeight> hws;
+    // External buffers, used instead of the vectors if set
+    std::shared_ptr<const void> memory;
+    const uint8_t* external_values{nullptr};
+    const uint64_t* external_validity{nullptr};
+    const HammingWeight* external_hws{nullptr};
+
+    const uint8_t* values_data() const {
+      return memory ? external_values : values.data();
+    }
+    const uint64_t* validity_data() const {
+      return memory ? external_validity : validity.data();
+    }
+    const HammingWeight* hws_data() const {
+      return memory ? external_hws : hws.data();
+    }
+  };
+
+  size_t bitsize_{0};
+  size_t offset{0}, size_{0};
+  std::shared_ptr<Buffers> buffers;
+
+  /**
+   * Makes sure that this column exclusively owns its buffers, copying the
+   * entries of a shared buffer or slice first
+   */
+  void detach();
+  void set_valid(size_t i, bool valid = true);
+  void check_entry_size(const Bitmask& entry) const;
+};
+
+/**
+ * Columns are equal if they have the same bitsize and entries
+ */
+bool operator==(const FieldColumn& a, const FieldColumn& b);
+inline bool operator!=(const FieldColumn& a, const FieldColumn& b) {
+  return !(a == b);
+}
+
+/**
+ * Throws invalid_argument if the column doesn't have the given size
+ */
+void check_column_size(const FieldColumn& column, size_t size,
+    const std::string& name);
+
+} // namespace sel
+
+#endif /* end of include guard: SEL_FIELD_COLUMN_H */
@@ -15,13 +15,16 @@ later version. This program is distributed in the hope that it will be useful,
 \brief Containes functions for the HeaderMethodHander
 */
 #include "headerhandlerfunctions.h"
+#include <cmath>
 #include <string>
 #include <map>
 #include <thread>
+#include <optional>
 #include "resttypes.h"
 #include "restbed"
 #include "restresponses.hpp"
 #include "serverhandler.h"
+#include "localserver.h"
 #include "configurationhandler.h"
 #include "remoteconfiguration.h"
 #include "connectionhandler.h"
@@ -31,6 +34,27 @@ later version. This program is distributed in the hope that it will be useful,
 using namespace std;
 namespace sel{
 
+namespace {
+
+/**
+ * Round trip time in ms sent by the client in the SEL-RTT header, if it is a
+ * valid, positive number
+ */
+optional<double> parse_rtt_header(const multimap<string,string>& header,
+                                  const shared_ptr<spdlog::logger>& logger) {
+  const auto rtt{header.find("SEL-RTT")};
+  if (rtt == header.end()) return nullopt;
+  try {
+    const double rtt_ms{stod(rtt->second)};
+    if (isfinite(rtt_ms) && rtt_ms > 0.) return rtt_ms;
+  } catch (const exception&) {
+  }
+  logger->warn("Ignoring invalid SEL-RTT header: {}", rtt->second);
+  return nullopt;
+}
+
+} // namespace
+
 SessionResponse init_mpc(const shared_ptr<restbed::Session>&,
                               const shared_ptr<const restbed::Request>&,
                               const multimap<string,string>& header,
@@ -60,8 +84,8 @@ SessionResponse init_mpc(const shared_ptr<restbed::Session>&,
   size_t server_record_number;
   shared_ptr<const ServerData> data;
   try {
-    server_record_number = DataHandler::get().poll_database(remote_id, counting_mode);
-    data = DataHandler::get().get_database();
+    data = DataHandler::get().get_current_database(remote_id);
+    server_record_number = data->data->begin()->second.size();
   } catch (const exception& e){
     logger->error("Error geting data from dataservice: {}", e.what());
     return sel::responses::status_error(restbed::INTERNAL_SERVER_ERROR, "Can not get data from dataservice");
@@ -76,8 +100,23 @@ SessionResponse init_mpc(const shared_ptr<restbed::Session>&,
                       {"Record-Number", to_string(server_record_number)},
                       {"SEL-Port", to_string(aby_server_port)},
                       {"Connection", "Close"}};
-  std::thread server_runner([remote_id, data, num_records, counting_mode]() {
-      ServerHandler::get().run_server(remote_id, data, num_records, counting_mode);
+  // The server decides on the sharing, as only it knows both input sizes
+  optional<SharingDecision> sharing;
+  const auto& server_config{ConfigurationHandler::cget().get_server_config()};
+  if (server_config.auto_sharing) {
+    NetworkProfile net{1., server_config.network_bandwidth};
+    if (const auto rtt_ms{parse_rtt_header(header, logger)}; rtt_ms) {
+      net.rtt_ms = *rtt_ms;
+    }
+    sharing = ServerHandler::cget().get_local_server(remote_id)
+      ->choose_sharing(num_records, server_record_number, net);
+    response.headers.emplace("SEL-Sharing",
+        sharing->choice.bool_sharing == BooleanSharing::YAO ? "yao" : "gmw");
+    response.headers.emplace("SEL-Conversion",
+        sharing->choice.use_conversion ? "true" : "false");
+  }
+  std::thread server_runner([remote_id, data, num_records, counting_mode, sharing]() {
+      ServerHandler::get().run_server(remote_id, data, num_records, counting_mode, sharing);
   });
   server_runner.detach();
   return response;
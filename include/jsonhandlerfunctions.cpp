@@ -26,6 +26,7 @@
 #include "authenticationconfig.hpp"
 #include "base64.h"
 #include "connectionhandler.h"
+#include "datahandler.h"
 #include "fmt/format.h"
 #include "localconfiguration.h"
 #include "logger.h"
@@ -74,6 +75,7 @@ SessionResponse valid_test_config_json_handler(
       RemoteAddress tempadr{remote_config->get_remote_host(),aby_port};
       std::thread server_creator([remote_id,tempadr](){ServerHandler::get().insert_server(remote_id, tempadr);});
       server_creator.detach();
+      DataHandler::get().start_refresher(remote_id);
       return responses::server_initialized(aby_port);
     } else {
       logger->error("Invalid Configs");
@@ -20,14 +20,19 @@
 #include "logger.h"
 #include "util.h"
 #include "base64.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 
 using namespace std;
 
 namespace sel {
 
-Bitmask check_size_and_get_as_bitmask(
-    const void* source, const size_t source_bytes, const size_t size_bitmask) {
+namespace {
+
+void check_size_and_copy_to_bitmask(const void* source,
+    const size_t source_bytes, const size_t size_bitmask, Bitmask& bitmask) {
   auto bytes_to_copy = size_bitmask;
   if (source_bytes < size_bitmask) {
     get_logger()->warn(
@@ -36,12 +41,12 @@ Bitmask check_size_and_get_as_bitmask(
   }
   // We don't log if source is larger because that's mostly the case
 
-  Bitmask ret(size_bitmask);
-  ::memcpy(ret.data(), source, bytes_to_copy);
-  return ret;
+  bitmask.assign(size_bitmask, 0);
+  ::memcpy(bitmask.data(), source, bytes_to_copy);
 }
 
-Bitmask check_size_and_get_as_bitmask(const string& source, const size_t size_bitmask) {
+void check_size_and_copy_to_bitmask(const string& source,
+    const size_t size_bitmask, Bitmask& bitmask) {
   auto logger = get_logger();
   auto bytes_to_copy = source.size();
   if (bytes_to_copy > size_bitmask) {
@@ -52,11 +57,16 @@ Bitmask check_size_and_get_as_bitmask(const string& source, const size_t size_bi
     logger->debug("String smaller than field bitlength, padding with zeros.");
   }
 
-  Bitmask ret(size_bitmask);
-  ::memcpy(ret.data(), source.c_str(), bytes_to_copy);
-  return ret;
+  bitmask.assign(size_bitmask, 0);
+  ::memcpy(bitmask.data(), source.c_str(), bytes_to_copy);
+}
+
+bool is_blank(const string& s) {
+  return all_of(s.cbegin(), s.cend(), [](unsigned char c) { return isspace(c); });
 }
 
+} // namespace
+
 void check_bitsize_and_clear_extra_bits(std::vector<uint8_t>& bitmask,
     const size_t size) {
   if (!(bitbytes(size) == bitmask.size()))
@@ -71,46 +81,76 @@ void check_bitsize_and_clear_extra_bits(std::vector<uint8_t>& bitmask,
   }
 }
 
+bool decode_field_value(const FieldSpec& field, double content,
+    Bitmask& bitmask) {
+  const size_t field_bytes = bitbytes(field.bitsize);
+  switch (field.type) {
+    case FieldType::INTEGER: {
+      const auto integer = static_cast<int>(content);
+      check_size_and_copy_to_bitmask(&integer, sizeof(int), field_bytes, bitmask);
+      return true;
+    }
+    case FieldType::NUMBER: {
+      check_size_and_copy_to_bitmask(&content, sizeof(double), field_bytes, bitmask);
+      return true;
+    }
+    default:
+      throw runtime_error(fmt::format("Invalid JSON Data: field {} expects a "
+            "string, got a number", field.name));
+  }
+}
+
+bool decode_field_value(const FieldSpec& field, const string& content,
+    Bitmask& bitmask) {
+  if (is_blank(content)) return false;
+  switch (field.type) {
+    case FieldType::STRING: {
+      check_size_and_copy_to_bitmask(content, bitbytes(field.bitsize), bitmask);
+      return true;
+    }
+    case FieldType::BITMASK: {
+      base64_decode(content, field.bitsize, bitmask);
+      check_bitsize_and_clear_extra_bits(bitmask, field.bitsize);
+      return true;
+    }
+    default:
+      throw runtime_error(fmt::format("Invalid JSON Data: field {} expects a "
+            "number, got a string", field.name));
+  }
+}
+
 FieldEntry parse_json_field(const FieldSpec& field,
                                             const nlohmann::json& json) {
-  auto logger{get_logger()};
-  if (!(json.is_null())) {
-    size_t field_bytes = bitbytes(field.bitsize);
-    switch (field.type) {
-      case FieldType::INTEGER: {
-        const auto content = json.get<int>();
-        return check_size_and_get_as_bitmask(&content, sizeof(int), field_bytes);
-      }
-      case FieldType::NUMBER: {
-        const auto content = json.get<double>();
-        return check_size_and_get_as_bitmask(&content, sizeof(double), field_bytes);
-      }
-      case FieldType::STRING: {
-        const auto content = json.get<string>();
-        if (trim_copy(content).empty()) {
-          return nullopt;
-        } else {
-          return check_size_and_get_as_bitmask(content, field_bytes);
-        }
-      }
-      case FieldType::BITMASK: {
-        const auto bloom_base64 = json.get<string>();
-        if (!trim_copy(bloom_base64).empty()) {
-          auto bloom = base64_decode(bloom_base64, field.bitsize);
-          check_bitsize_and_clear_extra_bits(bloom, field.bitsize);
-          return bloom;
-        } else {
-          return nullopt;
-        }
-      }
-      default: {
-        // silence compiler, never reached
-        return nullopt;
-      }
+  if (json.is_null()) return nullopt;
+  // nlohmann would convert booleans to numbers
+  if (json.is_boolean()) {
+    throw runtime_error(fmt::format("Invalid JSON Data: field {} got a boolean",
+          field.name));
+  }
+
+  Bitmask value;
+  bool non_empty;
+  switch (field.type) {
+    case FieldType::INTEGER: {
+      non_empty = decode_field_value(field, json.get<int>(), value);
+      break;
+    }
+    case FieldType::NUMBER: {
+      non_empty = decode_field_value(field, json.get<double>(), value);
+      break;
+    }
+    case FieldType::STRING:
+    case FieldType::BITMASK: {
+      non_empty = decode_field_value(field, json.get<string>(), value);
+      break;
+    }
+    default: {
+      // silence compiler, never reached
+      return nullopt;
     }
-  } else {  // field has type null
-    return nullopt;
   }
+  if (non_empty) return value;
+  return nullopt;
 }
 
 Record parse_json_fields(
@@ -126,18 +166,23 @@ Record parse_json_fields(
 VRecord parse_json_fields_array(
     const map<FieldName, FieldSpec>& fields, const nlohmann::json& json) {
   VRecord records;
+  parse_json_fields_array(fields, json, records);
+  return records;
+}
+
+void parse_json_fields_array(const map<FieldName, FieldSpec>& fields,
+    const nlohmann::json& json, VRecord& records) {
   for (const auto& rec : json) {
     if (!rec.count("fields")) {
       throw runtime_error("Invalid JSON Data: missing 'fields' in records array");
     }
 
     auto data_fields = parse_json_fields(fields, rec.at("fields"));
-    for (auto& fields : data_fields){
-      records[fields.first].emplace_back(move(fields.second));
+    for (auto& [name, entry] : data_fields){
+      auto column = records.try_emplace(name, fields.at(name).bitsize).first;
+      column->second.push_back(entry);
     }
   }
-
-  return records;
 }
 
 vector<string> parse_json_id_array(const nlohmann::json& json) {
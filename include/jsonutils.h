@@ -27,11 +27,23 @@
 
 namespace sel {
 
+/**
+ * Decode a field's value into bitmask, reusing its memory. Return false if the
+ * value is empty. Throw runtime_error if the value has the wrong type.
+ */
+bool decode_field_value(const FieldSpec&, double content, Bitmask& bitmask);
+bool decode_field_value(const FieldSpec&, const std::string& content,
+                        Bitmask& bitmask);
 FieldEntry parse_json_field(const FieldSpec&, const nlohmann::json&);
 Record parse_json_fields(const std::map<FieldName, FieldSpec>&,
                          const nlohmann::json&);
 VRecord parse_json_fields_array(const std::map<FieldName, FieldSpec>& fields,
                                 const nlohmann::json& json);
+/**
+ * Appends the records of the json array to the columns of records
+ */
+void parse_json_fields_array(const std::map<FieldName, FieldSpec>& fields,
+                             const nlohmann::json& json, VRecord& records);
 std::vector<std::string> parse_json_id_array(const nlohmann::json& json);
 std::map<FieldName, FieldSpec> parse_json_fields_config(
     nlohmann::json fields_json);
@@ -0,0 +1,118 @@
+/**
+ \file    linkage_plan.cpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Precompiled field comparisons of the EpiLink algorithm
+*/
+
+#include "linkage_plan.h"
+#include "logger.h"
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sel {
+
+namespace {
+
+/**
+ * All permutations of positions 0..size-1 in lexicographical order, which move
+ * at most max_exchanged positions (0: all permutations). Moving exactly one
+ * position is impossible, so 1 only leaves the identity.
+ */
+vector<vector<size_t>> bounded_permutations(size_t size, size_t max_exchanged) {
+  vector<size_t> perm(size);
+  iota(perm.begin(), perm.end(), 0);
+  vector<vector<size_t>> perms;
+  do {
+    size_t exchanged = 0;
+    for (size_t i = 0; i != size; ++i) exchanged += (perm[i] != i);
+    if (!max_exchanged || exchanged <= max_exchanged) perms.push_back(perm);
+  } while (next_permutation(perm.begin(), perm.end()));
+  return perms;
+}
+
+} // namespace
+
+LinkagePlan::LinkagePlan(const CircuitConfig& cfg) {
+  const auto& epi = cfg.epi;
+  map<pair<FieldId, FieldId>, size_t> comparison_ids;
+  const auto comparison_id = [&](FieldId left, FieldId right) {
+    const auto [it, inserted] = comparison_ids.try_emplace({left, right},
+        comparisons.size());
+    if (inserted) {
+      const auto weight =
+        (epi.field_specs[left].weight + epi.field_specs[right].weight)/2;
+      comparisons.push_back({left, right, weight,
+          cfg.rescaled_weight(left, right)});
+    }
+    return it->second;
+  };
+
+  for (const auto& group : epi.exchange_group_ids) {
+    ExchangeGroup xgroup{group, {}};
+    for (const auto& perm :
+        bounded_permutations(group.size(), cfg.max_exchanged_fields)) {
+      ComparisonIds perm_comparisons;
+      perm_comparisons.reserve(group.size());
+      for (size_t i = 0; i != group.size(); ++i) {
+        perm_comparisons.emplace_back(comparison_id(group[i], group[perm[i]]));
+      }
+      xgroup.permutations.emplace_back(move(perm_comparisons));
+    }
+    exchange_groups.emplace_back(move(xgroup));
+  }
+
+  for (const auto i : epi.single_field_ids) {
+    single_comparisons.emplace_back(comparison_id(i, i));
+  }
+
+  get_logger()->trace("Compiled LinkagePlan with {} comparisons, {} exchange "
+      "groups and {} single comparisons.", comparisons.size(),
+      exchange_groups.size(), single_comparisons.size());
+}
+
+vector<LinkagePlan::ExchangeGroupCost> LinkagePlan::exchange_group_costs() const {
+  vector<ExchangeGroupCost> costs;
+  costs.reserve(exchange_groups.size());
+  for (const auto& group : exchange_groups) {
+    set<size_t> group_comparisons;
+    for (const auto& perm : group.permutations) {
+      group_comparisons.insert(perm.cbegin(), perm.cend());
+    }
+    const auto size = group.fields.size();
+    const auto nperms = group.permutations.size();
+    costs.push_back({size, nperms, group_comparisons.size(),
+        nperms * (size - 1), nperms - 1});
+  }
+  return costs;
+}
+
+LinkagePlan::ExchangeGroupCost LinkagePlan::exchange_group_cost(size_t size,
+    size_t max_exchanged_fields) {
+  if (!size) throw invalid_argument("Exchange groups cannot be empty.");
+  const auto perms = bounded_permutations(size, max_exchanged_fields);
+  set<pair<size_t, size_t>> group_comparisons;
+  for (const auto& perm : perms) {
+    for (size_t i = 0; i != size; ++i) group_comparisons.emplace(i, perm[i]);
+  }
+  return {size, perms.size(), group_comparisons.size(),
+    perms.size() * (size - 1), perms.size() - 1};
+}
+
+} /* end of namespace: sel */
@@ -0,0 +1,96 @@
+/**
+ \file    linkage_plan.h
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Precompiled field comparisons of the EpiLink algorithm
+*/
+
+#ifndef SEL_LINKAGE_PLAN_H
+#define SEL_LINKAGE_PLAN_H
+#pragma once
+
+#include "circuit_config.h"
+#include <vector>
+
+namespace sel {
+
+/**
+ * A single comparison of client field left with server field right, together
+ * with its weight (w_left + w_right)/2, exact and rescaled.
+ */
+struct FieldComparison {
+  FieldId left, right;
+  Weight weight;
+  CircUnit rescaled_weight;
+};
+
+/**
+ * All field comparisons of the EpiLink algorithm, compiled once from a
+ * CircuitConfig, so that the circuit builder and the cleartext epilinker only
+ * need to execute them.
+ *
+ * The score of a database entry is the sum of the field weights of all
+ * single comparisons plus, for each exchange group, the sum of the field
+ * weights of the group's best permutation.
+ */
+struct LinkagePlan {
+  using ComparisonIds = std::vector<size_t>; // indices into comparisons
+
+  struct ExchangeGroup {
+    std::vector<FieldId> fields;
+    // For each permutation, the comparisons it sums up. In the order of
+    // std::next_permutation() of the sorted fields. Only permutations
+    // exchanging at most CircuitConfig::max_exchanged_fields fields, if set.
+    std::vector<ComparisonIds> permutations;
+  };
+
+  /**
+   * Number of operations to evaluate a single exchange group of given size:
+   * the comparisons are shared by all permutations, the additions sum up the
+   * field weights of each permutation and the selections are the quotient
+   * max-folding of all permutation weights.
+   *
+   * These are operations of the plan, not gates. Their gate counts depend on
+   * the sharing, word size and field comparators; test_sel with
+   * --exchange-cost-report builds the circuits and reports their AND gates.
+   */
+  struct ExchangeGroupCost {
+    size_t size, permutations, comparisons, additions, selections;
+  };
+
+  // All unique comparisons
+  std::vector<FieldComparison> comparisons;
+  std::vector<ExchangeGroup> exchange_groups;
+  // Comparisons of fields that are in no exchange group
+  ComparisonIds single_comparisons;
+
+  explicit LinkagePlan(const CircuitConfig& cfg);
+
+  std::vector<ExchangeGroupCost> exchange_group_costs() const;
+
+  /**
+   * Cost of an exchange group of given size, considering only permutations
+   * that exchange at most max_exchanged_fields fields (0: all permutations).
+   * Any bound of at least 2 still needs all size^2 comparisons, since every
+   * pair of fields is swapped by some permutation.
+   * Cheap to compute for small sizes, so that the growth of the circuit can be
+   * reported for different group sizes without building any circuit.
+   */
+  static ExchangeGroupCost exchange_group_cost(size_t size,
+      size_t max_exchanged_fields = 0);
+};
+
+} /* end of namespace: sel */
+
+#endif /* end of include guard: SEL_LINKAGE_PLAN_H */
@@ -77,13 +77,18 @@ LinkageJob::JobPreparation LinkageJob::prepare_run() {
   // Get number of records from server
   size_t num_records{m_records->size()};
   //this future trickery has to be done to properly wait for a reply
-  auto nvals{std::async(&LinkageJob::get_server_nvals, this, num_records)};
-  nvals.wait_for(15s);
-  if(!nvals.valid()){
+  auto reply_future{std::async(&LinkageJob::init_remote_mpc, this, num_records)};
+  reply_future.wait_for(15s);
+  if(!reply_future.valid()){
     throw runtime_error("Error retrieving number of records from server");
   }
-  const auto database_size{nvals.get()};
-  return {num_records, database_size, ServerHandler::get().get_epilink_client(m_remote_config->get_id())};
+  const auto reply{reply_future.get()};
+  auto epilinker{ServerHandler::get().get_epilink_client(m_remote_config->get_id())};
+  if (reply.sharing) {
+    get_logger(ComponentLogger::CLIENT)->info("Server chose {}", *reply.sharing);
+    epilinker->set_sharing(*reply.sharing);
+  }
+  return {num_records, reply.database_size, move(epilinker)};
 }
 
 
@@ -102,8 +107,8 @@ void LinkageJob::run_linkage_job() {
 #endif
     epilinker->set_client_input({move(m_records), database_size});
     auto linkage_share{epilinker->run_linkage()};
-      // reset epilinker for the next linkage
-      epilinker->reset();
+      // reset epilinker for the next linkage while we send the results
+      epilinker->reset_async();
       logger->info("Client Result: {}", linkage_share);
 #ifdef DEBUG_SEL_REST
       compute_debugging_result(input_copy);
@@ -138,8 +143,8 @@ void LinkageJob::run_matching_job() {
 #endif
     epilinker->set_input({move(m_records), database_size});
     auto count_result{epilinker->run_count()};
-      // reset epilinker for the next operation
-      epilinker->reset();
+      // reset epilinker for the next operation while we send the results
+      epilinker->reset_async();
       // The strange assembly of the json is due to strange object/array
       // distinctions in nlohmann/json
       nlohmann::json match_json;
@@ -167,9 +172,11 @@ void LinkageJob::set_local_config(shared_ptr<LocalConfiguration> l_config) {
 
 /**
  * Send server the configuration to compare and recieve back the number of
- * records in the database
+ * records in the database and, with autoSharing, the sharing to use.
+ * The probed round trip time, if any, is sent along for the server's cost
+ * model.
  */
-size_t LinkageJob::get_server_nvals(size_t num_records) {
+LinkageJob::InitMPCReply LinkageJob::init_remote_mpc(size_t num_records) {
   auto logger{get_logger(ComponentLogger::CLIENT)};
   //FIXME(TK): THIS IS BAD AND I SHOULD FEEL BAD
   std::this_thread::sleep_for(500ms);
@@ -178,6 +185,10 @@ size_t LinkageJob::get_server_nvals(size_t num_records) {
       "Record-Number: "s + to_string(num_records),
       "Counting-Mode: "s + (m_counting_job ? "true" : "false"),
       "Content-Type: application/json"};
+  // Without a probed round trip time, the server uses its default
+  if (const auto rtt{m_remote_config->get_network_rtt()}; rtt > 0.) {
+    headers.emplace_back("SEL-RTT: "s + to_string(rtt));
+  }
   string url{assemble_remote_url(m_remote_config) + "/initMPC/"+m_local_config->get_local_id()};
   logger->debug("Sending {} request to {}\n",(m_counting_job ? "matching" : "linkage"), url);
   try{
@@ -186,13 +197,22 @@ size_t LinkageJob::get_server_nvals(size_t num_records) {
     logger->debug("Response stream:\n{} - {}\n",response.return_code, response.body);
     // get nvals from response header
     if (response.return_code == 200) {
-      return stoull(get_headers(response.body, "Record-Number").front());
+      InitMPCReply reply{stoull(get_headers(response.body, "Record-Number").front()), nullopt};
+      const auto sharing{get_headers(response.body, "SEL-Sharing")};
+      const auto conversion{get_headers(response.body, "SEL-Conversion")};
+      if (!sharing.empty() && !conversion.empty()) {
+        reply.sharing = SharingChoice{
+          sharing.front() == "yao" ? BooleanSharing::YAO : BooleanSharing::GMW,
+          conversion.front() == "true"};
+      }
+      return reply;
     } else {
       logger->error("Error communicating with remote epilinker: {} - {}", response.return_code, response.body);
     }
   } catch (const exception& e) {
     logger->error("Error performing initMPC call: {}", e.what());
   }
+  throw runtime_error("Error retrieving number of records from server");
 }
 
 bool LinkageJob::perform_callback(const string& body) const {
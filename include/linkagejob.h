@@ -30,7 +30,9 @@
 #include <variant>
 #include <vector>
 #include <map>
+#include <optional>
 #include "epilink_input.h"
+#include "sharing_cost_model.h"
 
 namespace restbed {
 class Service;
@@ -49,6 +51,11 @@ class LinkageJob {
     size_t database_size;
     std::shared_ptr<SecureEpilinker> epilinker;
   };
+  struct InitMPCReply {
+    size_t database_size;
+    // Set if the server chose the sharing for this job
+    std::optional<SharingChoice> sharing;
+  };
  public:
    LinkageJob();
    LinkageJob(std::shared_ptr<const LocalConfiguration>, std::shared_ptr<const RemoteConfiguration>);
@@ -65,7 +72,7 @@ class LinkageJob {
    void set_local_config(std::shared_ptr<LocalConfiguration>);
  private:
   JobPreparation prepare_run();
-  size_t get_server_nvals(size_t);
+  InitMPCReply init_remote_mpc(size_t);
   bool perform_callback(const std::string&) const;
 #ifdef DEBUG_SEL_REST
   void compute_debugging_result(const Records&);
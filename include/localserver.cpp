@@ -58,7 +58,22 @@ RemoteId LocalServer::get_id() const {
   return m_remote_id;
 }
 
-void LocalServer::run_linkage(shared_ptr<const ServerData> data, size_t num_records) {
+SharingDecision LocalServer::choose_sharing(size_t num_records,
+    size_t database_size, const NetworkProfile& net) const {
+  return {m_cost_model.choose(num_records, database_size, net), net};
+}
+
+void LocalServer::calibrate_cost_model(const SharingDecision& sharing,
+    size_t num_records, size_t database_size) {
+  const auto cost{m_aby_server.get_run_cost()};
+  get_logger(ComponentLogger::SERVER)->debug("Run cost: depth {}, {} bytes, "
+      "{}ms", cost.depth, cost.bytes, cost.time_ms);
+  m_cost_model.calibrate(sharing.choice, num_records, database_size,
+      sharing.net, cost);
+}
+
+void LocalServer::run_linkage(shared_ptr<const ServerData> data,
+    size_t num_records, optional<SharingDecision> sharing) {
   m_data = move(data);
   auto logger{get_logger(ComponentLogger::SERVER)};
   logger->info("The linkage server is running");
@@ -66,11 +81,13 @@ void LocalServer::run_linkage(shared_ptr<const ServerData> data, size_t num_reco
 #ifdef DEBUG_SEL_REST
   DataHandler::get().get_epilink_debug()->server_input = *(m_data->data);
 #endif
+  if (sharing) m_aby_server.set_sharing(sharing->choice);
   m_aby_server.build_linkage_circuit(num_records, database_size);
   m_aby_server.run_setup_phase();
-  m_aby_server.set_server_input({m_data->data, num_records});
+  m_aby_server.set_server_input({m_data->data, m_data->prepared, num_records});
   auto linkage_result = m_aby_server.run_linkage();
-  m_aby_server.reset();
+  if (sharing) calibrate_cost_model(*sharing, num_records, database_size);
+  m_aby_server.reset_async();
 
   logger->debug("Server Result\n{}", linkage_result);
   string id_string;
@@ -99,19 +116,22 @@ void LocalServer::send_server_result_to_linkageservice(const vector<Result<CircU
 
 }
 
-void LocalServer::run_count(shared_ptr<const ServerData> data, size_t num_records) {
+void LocalServer::run_count(shared_ptr<const ServerData> data,
+    size_t num_records, optional<SharingDecision> sharing) {
   m_data = move(data);
 
   auto logger{get_logger()};
   logger->info("The server is running and performing its matching computations");
 
   const size_t database_size{m_data->data->begin()->second.size()};
+  if (sharing) m_aby_server.set_sharing(sharing->choice);
   m_aby_server.build_count_circuit(num_records, database_size);
   m_aby_server.run_setup_phase();
   logger->debug("Starting server matching computation");
-  m_aby_server.set_input({m_data->data, num_records});
+  m_aby_server.set_input({m_data->data, m_data->prepared, num_records});
   auto count_result = m_aby_server.run_count();
-  m_aby_server.reset();
+  if (sharing) calibrate_cost_model(*sharing, num_records, database_size);
+  m_aby_server.reset_async();
   logger->debug("Server Result\n{}", count_result);
 }
 
@@ -21,7 +21,9 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include "secure_epilinker.h"
+#include "sharing_cost_model.h"
 #include "seltypes.h"
 #include "resttypes.h"
 
@@ -42,8 +44,21 @@ class LocalServer {
               SecureEpilinker::ABYConfig,
               CircuitConfig);
   RemoteId get_id() const;
-  void run_linkage(std::shared_ptr<const ServerData>, size_t);
-  void run_count(std::shared_ptr<const ServerData>, size_t);
+  /**
+   * Runs the server side of a linkage or counting job. If a sharing decision
+   * is given, the circuit is built accordingly and the cost model is
+   * calibrated with the cost of the run.
+   */
+  void run_linkage(std::shared_ptr<const ServerData>, size_t,
+      std::optional<SharingDecision> = std::nullopt);
+  void run_count(std::shared_ptr<const ServerData>, size_t,
+      std::optional<SharingDecision> = std::nullopt);
+  /**
+   * Chooses sharing and conversion for a job from the cost model of the link
+   * to this remote. The client has to use the same choice.
+   */
+  SharingDecision choose_sharing(size_t num_records, size_t database_size,
+      const NetworkProfile& net) const;
   Port get_port() const;
   std::string get_ip() const;
   SecureEpilinker& get_epilinker();
@@ -53,11 +68,13 @@ class LocalServer {
 
  private:
   void send_server_result_to_linkageservice(const std::vector<Result<CircUnit>>&) const;
+  void calibrate_cost_model(const SharingDecision&, size_t, size_t);
   RemoteId m_remote_id;
   std::string m_client_ip;
   Port m_client_port;
   std::shared_ptr<const ServerData> m_data;
   SecureEpilinker m_aby_server;
+  SharingCostModel m_cost_model;
 };
 }  // namespace sel
 
@@ -0,0 +1,244 @@
+/**
+\file    pageparser.cpp
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Streaming parser of data service pages into database columns
+*/
+
+#include "pageparser.h"
+#include <stdexcept>
+#include "fmt/format.h"
+#include "jsonutils.h"
+
+using namespace std;
+namespace sel {
+
+PageParser::PageParser(const map<FieldName, FieldSpec>& fields,
+                       VRecord& records,
+                       vector<std::string>* ids,
+                       size_t expected_records)
+    : m_ids{ids} {
+  for (const auto& [name, field] : fields) {
+    auto& column{records.try_emplace(name, field.bitsize).first->second};
+    if (expected_records) column.reserve(column.size() + expected_records);
+    m_columns.emplace(name, Column{&field, &column, false});
+  }
+}
+
+void PageParser::parse(const std::string& page) {
+  if (!nlohmann::json::sax_parse(page, this)) {
+    throw runtime_error("Error parsing JSON from database: " + m_error);
+  }
+}
+
+bool PageParser::in_key(size_t depth, const char* key) const {
+  return !m_frames[depth].array && m_frames[depth].key == key;
+}
+
+bool PageParser::in_record(size_t depth) const {
+  const size_t p{m_page_depth};
+  return depth >= p + 3 && in_key(p, "records") && m_frames[p + 1].array &&
+         !m_frames[p + 2].array;
+}
+
+PageParser::Location PageParser::location() const {
+  const size_t p{m_page_depth};
+  const size_t depth{m_frames.size()};
+  if (depth <= p || m_frames[p].array) return Location::OTHER;
+  if (depth == p + 1) return Location::PAGE;
+  if (depth == p + 3 && in_key(p, "_links") && in_key(p + 1, "next") &&
+      in_key(p + 2, "href")) {
+    return Location::NEXT_PAGE;
+  }
+  if (!in_record(depth)) return Location::OTHER;
+  if (depth == p + 3 && in_key(p + 2, "id")) return Location::RECORD_ID;
+  if (depth == p + 4 && in_key(p + 2, "fields") && !m_frames[p + 3].array) {
+    return Location::FIELD;
+  }
+  return Location::OTHER;
+}
+
+PageParser::Column& PageParser::field_column() {
+  const auto& name{m_frames[m_page_depth + 3].key};
+  const auto it{m_columns.find(name)};
+  if (it == m_columns.end()) {
+    throw runtime_error(
+        fmt::format("Invalid JSON Data: unknown field '{}' in records array", name));
+  }
+  if (it->second.seen) {
+    throw runtime_error(
+        fmt::format("Invalid JSON Data: duplicate field '{}' in record", name));
+  }
+  it->second.seen = true;
+  return it->second;
+}
+
+void PageParser::begin_record() {
+  ++m_num_records;
+  m_has_fields = m_has_id = false;
+  for (auto& c : m_columns) c.second.seen = false;
+}
+
+void PageParser::end_record() {
+  if (!m_has_fields) {
+    throw runtime_error("Invalid JSON Data: missing 'fields' in records array");
+  }
+  if (m_ids && !m_has_id) {
+    throw runtime_error("Invalid JSON Data: missing 'id' in records array");
+  }
+  for (const auto& [name, c] : m_columns) {
+    if (!c.seen) {
+      throw runtime_error(fmt::format(
+          "Invalid JSON Data: missing field '{}' in records array", name));
+    }
+  }
+}
+
+bool PageParser::number(double val, optional<size_t> integer) {
+  switch (location()) {
+    case Location::PAGE: {
+      if (integer && in_key(m_page_depth, "lastPageNumber")) {
+        m_last_page = *integer;
+      } else if (integer && in_key(m_page_depth, "toDate")) {
+        m_todate = *integer;
+      }
+      break;
+    }
+    case Location::FIELD: {
+      auto& c{field_column()};
+      if (decode_field_value(*c.field, val, m_value)) {
+        c.column->push_back(m_value);
+      } else {
+        c.column->push_back(nullopt);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+bool PageParser::null() {
+  if (location() == Location::FIELD) field_column().column->push_back(nullopt);
+  return true;
+}
+
+bool PageParser::boolean(bool) {
+  if (location() == Location::FIELD) {
+    throw runtime_error(fmt::format("Invalid JSON Data: field {} got a boolean",
+          field_column().field->name));
+  }
+  return true;
+}
+
+bool PageParser::number_integer(number_integer_t val) {
+  return number(val, val >= 0 ? make_optional<size_t>(val) : nullopt);
+}
+
+bool PageParser::number_unsigned(number_unsigned_t val) {
+  return number(val, val);
+}
+
+bool PageParser::number_float(number_float_t val, const string_t&) {
+  return number(val, nullopt);
+}
+
+bool PageParser::string(string_t& val) {
+  switch (location()) {
+    case Location::PAGE: {
+      if (in_key(m_page_depth, "localId")) {
+        m_local_id = val;
+      } else if (in_key(m_page_depth, "remoteId")) {
+        m_remote_id = val;
+      }
+      break;
+    }
+    case Location::NEXT_PAGE: {
+      m_next_page = val;
+      break;
+    }
+    case Location::RECORD_ID: {
+      if (m_ids) m_ids->emplace_back(val);
+      m_has_id = true;
+      break;
+    }
+    case Location::FIELD: {
+      auto& c{field_column()};
+      if (decode_field_value(*c.field, val, m_value)) {
+        c.column->push_back(m_value);
+      } else {
+        c.column->push_back(nullopt);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+#if NLOHMANN_JSON_VERSION_MAJOR > 3 || \
+  (NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 8)
+bool PageParser::binary(binary_t&) {
+  return true;
+}
+#endif
+
+bool PageParser::start_object(std::size_t) {
+  const size_t p{m_page_depth};
+  if (m_frames.size() == p + 2 && in_key(p, "records") && m_frames[p + 1].array) {
+    begin_record();
+  }
+  m_frames.push_back({false, {}});
+  return true;
+}
+
+bool PageParser::key(string_t& val) {
+  const size_t p{m_page_depth};
+  const size_t depth{m_frames.size()};
+  if (depth == p + 1 && val == "_links") m_has_links = true;
+  if (depth == p + 1 && val == "records") m_has_records = true;
+  if (depth == p + 3 && in_record(depth) && val == "fields") m_has_fields = true;
+  m_frames.back().key = val;
+  return true;
+}
+
+bool PageParser::end_object() {
+  if (m_frames.size() == m_page_depth + 3 && in_record(m_frames.size())) {
+    end_record();
+  }
+  m_frames.pop_back();
+  return true;
+}
+
+bool PageParser::start_array(std::size_t) {
+  // The first page comes wrapped in an array
+  if (m_frames.empty()) m_page_depth = 1;
+  m_frames.push_back({true, {}});
+  return true;
+}
+
+bool PageParser::end_array() {
+  m_frames.pop_back();
+  return true;
+}
+
+bool PageParser::parse_error(std::size_t, const std::string&,
+                             const nlohmann::detail::exception& ex) {
+  m_error = ex.what();
+  return false;
+}
+
+}  // namespace sel
@@ -0,0 +1,120 @@
+/**
+\file    pageparser.h
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Streaming parser of data service pages into database columns
+*/
+
+#ifndef SEL_PAGEPARSER_H
+#define SEL_PAGEPARSER_H
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "epilink_input.h"
+#include "nlohmann/json.hpp"
+#include "resttypes.h"
+#include "seltypes.h"
+
+namespace sel {
+
+/**
+ * Parses a page of the data service with nlohmann's SAX interface, without
+ * building a DOM. The field values of all records are decoded and appended
+ * directly to the columns of the database. The page's metadata is kept for
+ * the fetcher.
+ */
+class PageParser : public nlohmann::json_sax<nlohmann::json> {
+ public:
+  /**
+   * Appends the records to the columns of records and their ids to ids, if
+   * not null. The columns are preallocated for expected_records more records.
+   */
+  PageParser(const std::map<FieldName, FieldSpec>& fields, VRecord& records,
+             std::vector<std::string>* ids, size_t expected_records = 0);
+
+  /**
+   * Parses the page, throws runtime_error if it is invalid
+   */
+  void parse(const std::string& page);
+
+  size_t num_records() const { return m_num_records; }
+  bool has_links() const { return m_has_links; }
+  bool has_records() const { return m_has_records; }
+  std::optional<unsigned> last_page() const { return m_last_page; }
+  std::optional<ToDate> todate() const { return m_todate; }
+  const std::optional<RemoteId>& local_id() const { return m_local_id; }
+  const std::optional<RemoteId>& remote_id() const { return m_remote_id; }
+  const std::optional<std::string>& next_page() const { return m_next_page; }
+
+  // SAX events
+  bool null() override;
+  bool boolean(bool val) override;
+  bool number_integer(number_integer_t val) override;
+  bool number_unsigned(number_unsigned_t val) override;
+  bool number_float(number_float_t val, const string_t& s) override;
+  bool string(string_t& val) override;
+#if NLOHMANN_JSON_VERSION_MAJOR > 3 || \
+  (NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 8)
+  bool binary(binary_t& val) override;
+#endif
+  bool start_object(std::size_t elements) override;
+  bool key(string_t& val) override;
+  bool end_object() override;
+  bool start_array(std::size_t elements) override;
+  bool end_array() override;
+  bool parse_error(std::size_t position, const std::string& last_token,
+                   const nlohmann::detail::exception& ex) override;
+
+ private:
+  enum class Location { OTHER, PAGE, NEXT_PAGE, RECORD_ID, FIELD };
+  struct Frame {
+    bool array;
+    std::string key;  // current key, if object
+  };
+  struct Column {
+    const FieldSpec* field;
+    FieldColumn* column;
+    bool seen;
+  };
+
+  std::vector<Frame> m_frames;
+  size_t m_page_depth{0};  // 1 if the page is wrapped in an array
+  std::map<FieldName, Column> m_columns;
+  std::vector<std::string>* m_ids;
+  Bitmask m_value;  // reused for all decoded values
+  bool m_has_fields{false}, m_has_id{false};
+  std::string m_error;
+
+  size_t m_num_records{0};
+  bool m_has_links{false}, m_has_records{false};
+  std::optional<unsigned> m_last_page;
+  std::optional<ToDate> m_todate;
+  std::optional<RemoteId> m_local_id, m_remote_id;
+  std::optional<std::string> m_next_page;
+
+  Location location() const;
+  bool in_key(size_t depth, const char* key) const;
+  bool in_record(size_t depth) const;
+  bool number(double val, std::optional<size_t> integer);
+  Column& field_column();
+  void begin_record();
+  void end_record();
+};
+
+}  // namespace sel
+
+#endif /* end of include guard: SEL_PAGEPARSER_H */
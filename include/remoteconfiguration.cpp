@@ -18,6 +18,7 @@
 
 #include "remoteconfiguration.h"
 #include <mutex>
+#include <chrono>
 #include "apikeyconfig.hpp"
 #include "logger.h"
 #include "resttypes.h"
@@ -87,6 +88,10 @@ bool RemoteConfiguration::get_mutual_initialization_status() const {
   return m_mutually_initialized;
 }
 
+double RemoteConfiguration::get_network_rtt() const {
+  return m_network_rtt;
+}
+
 void RemoteConfiguration::test_configuration(
     const RemoteId& client_id,
     const nlohmann::json& client_config) {
@@ -97,7 +102,11 @@ void RemoteConfiguration::test_configuration(
   string url{assemble_remote_url(this) + "/testConfig/" + client_id};
 
   logger->debug("Sending config test to: {}\n", url);
+  // The config test doubles as probe of the round trip time for the
+  // SharingCostModel. It includes the remote's (short) processing time.
+  const auto probe_start{chrono::steady_clock::now()};
   auto response{perform_post_request(url, data, headers, true)};
+  const chrono::duration<double, milli> rtt{chrono::steady_clock::now() - probe_start};
   logger->trace("Config test response:\n{} - {}\n", response.return_code, response.body );
 
   if(response.body.find("No connection initialized") != response.body.npos){
@@ -112,6 +121,8 @@ void RemoteConfiguration::test_configuration(
   if (!aby_server_port.empty()) {
     logger->info("Client registered aby Port {}", aby_server_port.front());
     set_aby_port(stoul(aby_server_port.front()));
+    m_network_rtt = rtt.count();
+    logger->debug("Probed round trip time: {}ms", rtt.count());
     mark_mutually_initialized();
     std::thread client_creator([this](){ServerHandler::get().insert_client(m_remote_id);});
     client_creator.detach();
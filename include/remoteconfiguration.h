@@ -20,6 +20,7 @@
 #define SEL_REMOTECONFIGURATION_H
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -63,6 +64,12 @@ class RemoteConfiguration {
 
   bool get_mutual_initialization_status() const;
 
+  /**
+   * Round trip time to the remote in milliseconds, as probed during the last
+   * configuration test. 0 if not probed yet.
+   */
+  double get_network_rtt() const;
+
   void test_configuration(const RemoteId&, const nlohmann::json&);
   void test_linkage_service() const;
   void mark_mutually_initialized() const; // changes mutable flag
@@ -74,6 +81,8 @@ class RemoteConfiguration {
   Port m_aby_port;
   bool m_matching_mode{false};
   mutable bool m_mutually_initialized{false};
+  // Written by the configuration test, read by linkage jobs
+  std::atomic<double> m_network_rtt{0.};
 };
 
 }  // Namespace sel
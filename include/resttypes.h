@@ -26,7 +26,7 @@
 #include <string>
 #include <set>
 
-#include "circuit_config.h" // for BooleanSharing
+#include "circuit_config.h" // for BooleanSharing, BitLen
 #include <filesystem>
 
 namespace sel {
@@ -71,6 +71,31 @@ struct ServerConfig {
   uint32_t aby_threads;
   BooleanSharing boolean_sharing;
   std::set<Port> avaliable_aby_ports;
+  bool batch_records = false;
+  size_t chunk_size = 0;
+  size_t max_exchanged_fields = 0;
+  // Choose boolean sharing and conversion per job with the SharingCostModel
+  bool auto_sharing = false;
+  double network_bandwidth = 1000.; // Mbit/s, for the cost model
+  // Circuit word size: 16, 32 or 64 bits. 0 selects the smallest that fits
+  size_t word_size = BitLen;
+  // Seconds between background refreshes of each remote's database, 0 polls
+  // the database on every linkage request instead
+  size_t database_refresh_interval = 0;
+  // Maximum age in seconds of a background refreshed database before a
+  // linkage request polls it itself, 0 for three refresh intervals
+  size_t database_max_staleness = 0;
+  // Number of database pages fetched concurrently
+  size_t database_fetch_window = 4;
+  // Directory of the database snapshots that restarts resume from, empty to
+  // disable snapshots
+  std::filesystem::path database_snapshot_directory;
+  // Seconds between full polls of each remote's database, which drop the
+  // records deleted from the data service. 0 only polls the changes.
+  size_t database_full_sync_interval = 3600;
+  // Read integer division circuits from circuit_directory instead of
+  // generating them
+  bool use_int_div_files = false;
 };
 
 } // namespace sel
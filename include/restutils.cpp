@@ -97,7 +97,23 @@ ServerConfig parse_json_server_config(const nlohmann::json& json) {
           get_checked_result<size_t>(json,"defaultPageSize"),
           get_checked_result<uint32_t>(json,"abyThreads"),
           boolean_sharing,
-          aby_ports};
+          aby_ports,
+          get_checked_result_or<bool>(json,"batchRecords",false),
+          get_checked_result_or<size_t>(json,"linkageChunkSize",0),
+          get_checked_result_or<size_t>(json,"maxExchangedFields",0),
+          get_checked_result_or<bool>(json,"autoSharing",false),
+          get_checked_result_or<double>(json,"networkBandwidth",1000.),
+          get_checked_result_or<size_t>(json,"circuitWordSize",BitLen),
+          get_checked_result_or<size_t>(json,"databaseRefreshInterval",0),
+          get_checked_result_or<size_t>(json,"databaseMaxStaleness",0),
+          get_checked_result_or<size_t>(json,"databaseFetchWindow",4),
+          get_checked_result_or<string>(json,"databaseSnapshotDirectory",""),
+          get_checked_result_or<size_t>(json,"databaseFullSyncInterval",3600),
+          get_checked_result_or<bool>(json,"useIntDivFiles",false)};
+  if (result.word_size && !is_word_size(result.word_size)) {
+    throw runtime_error("Invalid circuitWordSize: choose 16, 32, 64 or 0 "
+        "for the smallest that fits the fields.");
+  }
   test_server_config_paths(result);
   return result;
 }
@@ -51,6 +51,17 @@ T get_checked_result(const nlohmann::json& j, const std::string& field_name){
     throw std::runtime_error("Wrong type in config");
 }
 
+/**
+ * Like get_checked_result, but returns the given default if the field is
+ * missing, for optional configuration keys.
+ */
+template <typename T>
+T get_checked_result_or(const nlohmann::json& j, const std::string& field_name,
+    const T& default_value){
+  if(j.find(field_name) == j.end()) return default_value;
+  return get_checked_result<T>(j, field_name);
+}
+
 template <> std::set<Port> get_checked_result<std::set<Port>>(const nlohmann::json& j, const std::string& field_name);
 
 void throw_if_nonexisting_file(const std::filesystem::path&);
@@ -44,8 +44,20 @@ e_role to_aby_role(MPCRole r) {
   return r == MPCRole::CLIENT ? CLIENT : SERVER;
 }
 
+/**
+ * ABY's bitlen of arithmetic shares, which must be one of the WordSizes
+ */
+uint32_t checked_word_size(size_t bitlen) {
+  if (!is_word_size(bitlen)) {
+    throw invalid_argument(fmt::format("Unsupported circuit word size {}. "
+          "Choose 16, 32 or 64 bits.", bitlen));
+  }
+  return bitlen;
+}
+
 SecureEpilinker::SecureEpilinker(ABYConfig config, CircuitConfig circuit_config) :
-  party{make_unique<ABYParty>(to_aby_role(config.role), config.host, config.port, LT, BitLen, config.nthreads)},
+  party{make_unique<ABYParty>(to_aby_role(config.role), config.host, config.port,
+      LT, checked_word_size(circuit_config.bitlen), config.nthreads)},
   bcirc{dynamic_cast<BooleanCircuit*>(party->GetSharings()[to_aby_sharing(circuit_config.bool_sharing)]
       ->GetCircuitBuildRoutine())},
   ccirc{dynamic_cast<BooleanCircuit*>(party->GetSharings()[to_aby_sharing(other(circuit_config.bool_sharing))]
@@ -59,7 +71,16 @@ SecureEpilinker::SecureEpilinker(ABYConfig config, CircuitConfig circuit_config)
 
 // Need to _declare_ in header but _define_ here because we use a unique_ptr
 // pimpl.
-SecureEpilinker::~SecureEpilinker() = default;
+SecureEpilinker::~SecureEpilinker() {
+  wait_for_reset();
+}
+
+void SecureEpilinker::wait_for_reset() {
+  if (pending_reset.valid()) {
+    get_logger()->trace("Waiting for background reset to finish...");
+    pending_reset.get();
+  }
+}
 
 void SecureEpilinker::connect() {
   const auto& logger = get_logger();
@@ -73,6 +94,47 @@ State SecureEpilinker::get_state() {
   return state;
 }
 
+void SecureEpilinker::set_sharing(const SharingChoice& choice) {
+  if (state.built) {
+    throw runtime_error("Set sharing before building the circuit!");
+  }
+  if (choice.bool_sharing == cfg.bool_sharing
+      && choice.use_conversion == cfg.use_conversion) return;
+
+  wait_for_reset();
+  get_logger()->debug("Switching to {}.", choice);
+  cfg.bool_sharing = choice.bool_sharing;
+  cfg.use_conversion = choice.use_conversion;
+  bcirc = dynamic_cast<BooleanCircuit*>(party->GetSharings()[
+      to_aby_sharing(cfg.bool_sharing)]->GetCircuitBuildRoutine());
+  ccirc = dynamic_cast<BooleanCircuit*>(party->GetSharings()[
+      to_aby_sharing(other(cfg.bool_sharing))]->GetCircuitBuildRoutine());
+  selc = make_unique_circuit_builder(cfg, bcirc, ccirc, acirc);
+}
+
+SharingChoice SecureEpilinker::get_sharing() const {
+  return {cfg.bool_sharing, cfg.use_conversion};
+}
+
+RunCost SecureEpilinker::get_party_cost() const {
+  return {party->GetTotalDepth(),
+    party->GetSentData(P_SETUP) + party->GetReceivedData(P_SETUP)
+      + party->GetSentData(P_ONLINE) + party->GetReceivedData(P_ONLINE),
+    party->GetTiming(P_SETUP) + party->GetTiming(P_ONLINE)};
+}
+
+void add_cost(RunCost& total, const RunCost& cost) {
+  total.depth += cost.depth;
+  total.bytes += cost.bytes;
+  total.time_ms += cost.time_ms;
+}
+
+RunCost SecureEpilinker::get_run_cost() const {
+  auto cost = chunks_cost;
+  add_cost(cost, get_party_cost());
+  return cost;
+}
+
 void SecureEpilinker::build_linkage_circuit(const size_t num_records, const size_t database_size) {
   build_circuit(num_records, database_size);
   state.matching_mode = false;
@@ -84,6 +146,7 @@ void SecureEpilinker::build_count_circuit(const size_t num_records, const size_t
 void SecureEpilinker::build_circuit(const size_t num_records_, const size_t database_size_) {
   // TODO When separation of setup, online phase and input setting is done in
   // ABY, call selc->build_circuit() here instead of in run()
+  wait_for_reset();
   state.num_records = num_records_;
   state.database_size = database_size_;
   state.built = true;
@@ -108,21 +171,101 @@ void check_state_for_input(const State& state,
 
 void SecureEpilinker::run_setup_phase() {
   throw_if_not_built(state.built, "running setup phase");
+  wait_for_reset();
   state.setup = true;
 }
 
+bool is_chunked(const CircuitConfig& cfg, size_t database_size) {
+  return cfg.chunk_size && cfg.chunk_size < database_size;
+}
+
 void SecureEpilinker::set_client_input(const EpilinkClientInput& input) {
   check_state_for_input(state, input);
-  selc->set_input(input);
+  if (is_chunked(cfg, input.database_size)) {
+    chunked_client_input.emplace(make_unique<Records>(*input.records),
+        input.database_size);
+  } else {
+    selc->set_input(input);
+  }
   state.input_set = true;
 }
 
 void SecureEpilinker::set_server_input(const EpilinkServerInput& input) {
   check_state_for_input(state, input);
-  selc->set_input(input);
+  if (is_chunked(cfg, input.database_size)) {
+    chunked_server_input = input;
+  } else {
+    selc->set_input(input);
+  }
   state.input_set = true;
 }
 
+/**
+ * The client links its records against each chunk of the remote database
+ */
+EpilinkClientInput slice_input(const EpilinkClientInput& input,
+    [[maybe_unused]] size_t offset, size_t length) {
+  return {make_unique<Records>(*input.records), length};
+}
+
+EpilinkServerInput slice_input(const EpilinkServerInput& input,
+    size_t offset, size_t length) {
+  // Slices share the buffers of the whole database
+  VRecord chunk;
+  for (const auto& [name, column] : *input.database) {
+    chunk.emplace(name, column.slice(offset, length));
+  }
+  return {make_shared<VRecord>(move(chunk)), input.prepared, input.num_records,
+    input.prepared_offset + offset};
+}
+
+vector<LinkageCarry> to_carry(vector<ChunkOutputShares>& outputs) {
+  vector<LinkageCarry> carry;
+  for (auto& o : outputs) {
+    const auto num = o.num.get_clear_value_vec();
+    const auto den = o.den.get_clear_value_vec();
+    const auto index = o.index.get_clear_value_vec();
+    for (size_t i = 0; i != index.size(); ++i) {
+      carry.push_back({num[i], den[i], index[i]});
+    }
+  }
+  return carry;
+}
+
+void SecureEpilinker::run_chunks() {
+  chunks_cost = {};
+  if (chunked_client_input) {
+    run_chunks(*chunked_client_input);
+    chunked_client_input.reset();
+  } else if (chunked_server_input) {
+    run_chunks(*chunked_server_input);
+    chunked_server_input.reset();
+  }
+}
+
+template <class EpilinkInput>
+void SecureEpilinker::run_chunks(const EpilinkInput& input) {
+  const size_t total = input.database_size;
+  vector<LinkageCarry> carry;
+  size_t offset = 0;
+  for (; offset + cfg.chunk_size < total; offset += cfg.chunk_size) {
+    get_logger()->debug("Linking database chunk [{}, {}) of {} records...",
+        offset, offset + cfg.chunk_size, total);
+    selc->set_chunk({offset, total, move(carry)});
+    selc->set_input(slice_input(input, offset, cfg.chunk_size));
+    auto outputs = selc->build_chunk_circuit();
+    party->ExecCircuit();
+    carry = to_carry(outputs);
+    // Reset() clears the statistics of the chunk
+    add_cost(chunks_cost, get_party_cost());
+    selc->reset();
+    party->Reset();
+  }
+  get_logger()->debug("Linking last database chunk [{}, {}).", offset, total);
+  selc->set_chunk({offset, total, move(carry)});
+  selc->set_input(slice_input(input, offset, total - offset));
+}
+
 #ifdef DEBUG_SEL_CIRCUIT
 void SecureEpilinker::set_both_inputs(
     const EpilinkClientInput& in_client, const EpilinkServerInput& in_server) {
@@ -134,6 +277,14 @@ void SecureEpilinker::set_both_inputs(
 }
 #endif
 
+/**
+ * Whether the given bit of the 2-bit match output is set. Output shares are
+ * XOR shares, so each bit is a share of its own.
+ */
+bool match_bit(CircUnit match_bits, uint32_t bit) {
+  return (match_bits >> bit) & 1;
+}
+
 Result<CircUnit> to_clear_value(LinkageOutputShares& res, [[maybe_unused]] size_t dice_prec) {
 #ifdef DEBUG_SEL_RESULT
     const auto sum_field_weights = res.score_numerator.get_clear_value<CircUnit>();
@@ -145,14 +296,45 @@ Result<CircUnit> to_clear_value(LinkageOutputShares& res, [[maybe_unused]] size_
     const CircUnit sum_weights = 0;
 #endif
 
+  const auto match_bits = res.match_bits.get_clear_value<CircUnit>();
   return {
     res.index.get_clear_value<CircUnit>(),
-    res.match.get_clear_value<bool>(),
-    res.tmatch.get_clear_value<bool>(),
+    match_bit(match_bits, MatchBit),
+    match_bit(match_bits, TMatchBit),
     sum_field_weights, sum_weights
   };
 }
 
+/**
+ * Returns the results of all records contained in the SIMD output shares, as
+ * present in batched mode.
+ */
+vector<Result<CircUnit>> to_clear_values(LinkageOutputShares& res,
+    [[maybe_unused]] size_t dice_prec) {
+  if (res.index.get_nvals() == 1) return {to_clear_value(res, dice_prec)};
+
+  const auto index = res.index.get_clear_value_vec();
+  const auto match_bits = res.match_bits.get_clear_value_vec();
+#ifdef DEBUG_SEL_RESULT
+  const auto sum_field_weights = res.score_numerator.get_clear_value_vec();
+  const auto sum_weights = res.score_denominator.get_clear_value_vec();
+#endif
+
+  vector<Result<CircUnit>> results;
+  results.reserve(index.size());
+  for (size_t i = 0; i != index.size(); ++i) {
+#ifdef DEBUG_SEL_RESULT
+    results.push_back({index[i], match_bit(match_bits[i], MatchBit),
+        match_bit(match_bits[i], TMatchBit),
+        sum_field_weights[i], sum_weights[i] << dice_prec});
+#else
+    results.push_back({index[i], match_bit(match_bits[i], MatchBit),
+        match_bit(match_bits[i], TMatchBit), 0, 0});
+#endif
+  }
+  return results;
+}
+
 
 vector<Result<CircUnit>> SecureEpilinker::run_linkage() {
   if (!state.setup) {
@@ -161,14 +343,17 @@ vector<Result<CircUnit>> SecureEpilinker::run_linkage() {
     run_setup_phase();
   }
 
+  run_chunks();
   auto results = selc->build_linkage_circuit();
   get_logger()->trace("Executing ABYParty Circuit...");
   party->ExecCircuit();
   get_logger()->trace("ABYParty Circuit executed.");
 
-  auto clear_results = transform_vec(results, [dice_prec=cfg.dice_prec](auto r){
-        return to_clear_value(r, dice_prec);
-      });
+  vector<Result<CircUnit>> clear_results;
+  for (auto& r : results) {
+    auto rs = to_clear_values(r, cfg.dice_prec);
+    clear_results.insert(clear_results.end(), rs.begin(), rs.end());
+  }
   state.reset(); // need to setup new circuit
   return clear_results;
 }
@@ -187,6 +372,7 @@ CountResult<CircUnit> SecureEpilinker::run_count() {
     run_setup_phase();
 
   }
+  run_chunks();
   auto results = selc->build_count_circuit();
   get_logger()->trace("Executing ABYParty Circuit...");
   party->ExecCircuit();
@@ -206,11 +392,26 @@ void SecureEpilinker::State::reset() {
 }
 
 void SecureEpilinker::reset() {
+  wait_for_reset();
+  chunked_client_input.reset();
+  chunked_server_input.reset();
   selc->reset();
   party->Reset();
   state.reset();
 }
 
+void SecureEpilinker::reset_async() {
+  wait_for_reset();
+  chunked_client_input.reset();
+  chunked_server_input.reset();
+  state.reset();
+  pending_reset = async(launch::async, [this] {
+      selc->reset();
+      party->Reset();
+      get_logger()->trace("Background reset done.");
+    });
+}
+
 #ifdef SEL_STATS
 sel::aby::StatsPrinter SecureEpilinker::get_stats_printer() {
   return sel::aby::StatsPrinter(*party);
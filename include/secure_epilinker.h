@@ -24,6 +24,9 @@
 #include "epilink_input.h"
 #include "epilink_result.hpp"
 #include "circuit_config.h"
+#include "sharing_cost_model.h"
+#include <optional>
+#include <future>
 #ifdef SEL_STATS
 #include "aby/statsprinter.h"
 #endif
@@ -69,12 +72,23 @@ public:
    */
   void connect();
 
+  /**
+   * Switches boolean sharing and arithmetic conversion for the next circuit.
+   * Must be called before build_*_circuit(). Both parties need to make the
+   * same choice.
+   */
+  void set_sharing(const SharingChoice& choice);
+  SharingChoice get_sharing() const;
+
   void build_linkage_circuit(const size_t num_records, const size_t database_size);
   void build_count_circuit(const size_t num_records, const size_t database_size);
 
   /*
    * TODO The separation of setup and online phase is currently not possible in
    * ABY. Until it is, this will all happen in the run_* methods...
+   * The setup phase is thus neither precomputed nor run ahead of the online
+   * phase, ExecCircuit() still runs both. For now, this only waits for a
+   * pending background reset from reset_async().
    */
   void run_setup_phase();
 
@@ -105,8 +119,22 @@ public:
    */
   void reset();
 
+  /**
+   * Like reset(), but the circuits and the ABY Party are torn down in the
+   * background, so that the caller can continue, e.g., with sending the
+   * results. The next build_*_circuit() waits for it to finish.
+   * Only the teardown is moved off the critical path, no setup phase work.
+   */
+  void reset_async();
+
   State get_state();
 
+  /**
+   * Communication and timing of the last run, including all chunks of a
+   * chunked run, to be called before reset().
+   */
+  RunCost get_run_cost() const;
+
 #ifdef SEL_STATS
   sel::aby::StatsPrinter get_stats_printer();
 #endif
@@ -116,10 +144,15 @@ private:
   BooleanCircuit* bcirc; // boolean circuit for boolean parts
   BooleanCircuit* ccirc; // intermediate conversion circuit
   ArithmeticCircuit* acirc;
-  const CircuitConfig cfg;
+  CircuitConfig cfg;
 
   std::unique_ptr<CircuitBuilderBase> selc; // ~pimpl
 
+  // Pending reset_async(). Declared after party and selc so that it is
+  // destroyed (and waited for) first.
+  std::future<void> pending_reset;
+  void wait_for_reset();
+
   /*
    * Note that we currently maintain an outside-facing state that behaves as if
    * aby already has the separation of circuit building/setup/input setting.
@@ -128,6 +161,24 @@ private:
    */
   State state;
 
+  /*
+   * If the database is larger than the configured chunk size, the inputs are
+   * kept here and the chunks are set one after another during run_*().
+   */
+  std::optional<EpilinkClientInput> chunked_client_input;
+  std::optional<EpilinkServerInput> chunked_server_input;
+  // Summed cost of the chunks run so far, whose ABY statistics are reset
+  RunCost chunks_cost{};
+  RunCost get_party_cost() const;
+
+  /*
+   * Runs all but the last chunk of a chunked linkage and sets the input of the
+   * last chunk, so that the final circuit can be built by run_*().
+   */
+  void run_chunks();
+  template <class EpilinkInput>
+  void run_chunks(const EpilinkInput& input);
+
   /*
    * TODO It is currently not possible to build an ABY circuit without
    * specifying the inputs, as all circuits start with the InputGates. Hence,
@@ -147,7 +198,7 @@ struct formatter<sel::SecureEpilinker::ABYConfig> {
 
   template <typename FormatContext>
   auto format(const sel::SecureEpilinker::ABYConfig& conf, FormatContext &ctx) {
-    return format_to(ctx.begin(),
+    return format_to(ctx.out(),
         "ABYConfig{{role={}, sharing={}, {}={}:{}, threads={}}}",
         ((conf.role == sel::MPCRole::SERVER) ? "Server" : "Client"),
         ((conf.role == sel::MPCRole::SERVER) ? "binding to" : "remote host"),
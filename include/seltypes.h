@@ -34,6 +34,8 @@ namespace sel {
 
 using FieldName = std::string;
 using IndexSet = std::set<FieldName>;
+// dense field index, see EpilinkConfig
+using FieldId = size_t;
 // weight type
 using Weight = double;
 using VWeight = std::vector<Weight>;
@@ -89,7 +91,7 @@ struct formatter<sel::FieldComparator> {
       case sel::FieldComparator::BINARY: s = "Binary"; break;
       case sel::FieldComparator::DICE: s = "Bitmask"; break;
     }
-    return format_to(ctx.begin(), s);
+    return format_to(ctx.out(), s);
   }
 };
 
@@ -100,7 +102,7 @@ struct formatter<sel::FieldSpec> {
 
   template <typename FormatContext>
   auto format(const sel::FieldSpec& field, FormatContext &ctx) {
-    return format_to(ctx.begin(),
+    return format_to(ctx.out(),
         "ML_Field{{name={}, weight={}, comp={}, type={}, bitsize={}}}",
         field.name, field.weight, field.comparator, ftype_to_str(field.type), field.bitsize
         );
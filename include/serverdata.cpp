@@ -0,0 +1,57 @@
+/**
+\file    serverdata.cpp
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Database of a remote party as input to the linkage server
+*/
+
+#include "serverdata.h"
+#include <unordered_map>
+
+using namespace std;
+namespace sel {
+
+ServerData merge_database_diff(const ServerData& cached, ServerData&& diff) {
+  // Copied columns share their buffers until they are written to
+  VRecord records{*cached.data};
+  vector<string> ids{*cached.ids};
+  unordered_map<string, size_t> index;
+  index.reserve(ids.size());
+  for (size_t i = 0; i != ids.size(); ++i) index.emplace(ids[i], i);
+
+  for (size_t j = 0; j != diff.ids->size(); ++j) {
+    const auto& id{diff.ids->at(j)};
+    const auto [it, inserted] = index.try_emplace(id, ids.size());
+    if (inserted) ids.emplace_back(id);
+    for (auto& [name, column] : records) {
+      const auto entry{diff.data->at(name).entry(j)};
+      if (inserted) {
+        column.push_back(entry);
+      } else {
+        column.set(it->second, entry);
+      }
+    }
+  }
+
+  ServerData merged;
+  merged.data = make_shared<VRecord>(move(records));
+  merged.ids = make_shared<vector<string>>(move(ids));
+  merged.todate = diff.todate;
+  merged.local_id = move(diff.local_id);
+  merged.remote_id = move(diff.remote_id);
+  merged.full_sync_time = cached.full_sync_time;
+  return merged;
+}
+
+}  // namespace sel
@@ -0,0 +1,56 @@
+/**
+\file    serverdata.h
+\author  Tobias Kussel <kussel@cbs.tu-darmstadt.de>
+\copyright SEL - Secure EpiLinker
+    Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+\brief Database of a remote party as input to the linkage server
+*/
+
+#ifndef SEL_SERVERDATA_H
+#define SEL_SERVERDATA_H
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "epilink_input.h"
+#include "resttypes.h"
+
+namespace sel {
+
+struct ServerData {
+  std::shared_ptr<VRecord> data;
+  std::shared_ptr<std::vector<std::string>> ids;
+  ToDate todate;
+  RemoteId local_id;
+  RemoteId remote_id;
+  // Preprocessed server input, reused by all jobs until the database changes
+  std::shared_ptr<const PreparedDatabase> prepared;
+  std::chrono::steady_clock::time_point fetch_time{
+    std::chrono::steady_clock::now()};
+  // Start of the last full poll, which also drops deleted records. Wall clock
+  // time, as it outlives restarts in snapshots.
+  std::chrono::system_clock::time_point full_sync_time{};
+};
+
+/**
+ * Merges the changed records of diff into a copy of cached. Records with known
+ * ids keep their index, records with new ids are appended. The result has the
+ * toDate and party ids of diff and the full sync time of cached.
+ */
+ServerData merge_database_diff(const ServerData& cached, ServerData&& diff);
+
+}  // namespace sel
+
+#endif /* end of include guard: SEL_SERVERDATA_H */
@@ -152,15 +152,16 @@ std::shared_ptr<LocalServer> ServerHandler::get_local_server(const RemoteId& rem
 
 void ServerHandler::run_server(const RemoteId& remote_id,
                                std::shared_ptr<const ServerData> data,
-                               size_t num_records, bool counting_mode) {
+                               size_t num_records, bool counting_mode,
+                               optional<SharingDecision> sharing) {
   const auto& config_handler{ConfigurationHandler::cget()};
   auto remote_config{config_handler.get_remote_config(remote_id)};
   auto local_config{config_handler.get_local_config()};
   if (remote_config->get_mutual_initialization_status()) {
     if (!counting_mode) {
-      get_local_server(remote_id)->run_linkage(move(data), num_records);
+      get_local_server(remote_id)->run_linkage(move(data), num_records, sharing);
     } else if(remote_config->get_matching_mode()){ // Matching mode
-      get_local_server(remote_id)->run_count(move(data), num_records);
+      get_local_server(remote_id)->run_count(move(data), num_records, sharing);
     } else {
       m_logger->error("Matching mode not allowed for remote");
     }
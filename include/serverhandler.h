@@ -25,8 +25,10 @@
 #include "connectionhandler.h"
 #include "serialworker.hpp"
 #include "logger.h"
+#include "sharing_cost_model.h"
 #include <map>
 #include <memory>
+#include <optional>
 
 namespace sel {
 
@@ -48,7 +50,8 @@ class ServerHandler {
     std::shared_ptr<LocalServer> get_local_server(const RemoteId&) const;
     Port get_server_port(const RemoteId&) const;
     std::shared_ptr<SecureEpilinker> get_epilink_client(const RemoteId&);
-    void run_server(const RemoteId&, std::shared_ptr<const ServerData>, size_t, bool);
+    void run_server(const RemoteId&, std::shared_ptr<const ServerData>, size_t,
+        bool, std::optional<SharingDecision> = std::nullopt);
     void connect_client(const RemoteId&);
   protected:
     ServerHandler() = default;
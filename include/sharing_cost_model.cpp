@@ -0,0 +1,130 @@
+/**
+ \file    sharing_cost_model.cpp
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Cost model to choose the boolean sharing and conversion per job
+*/
+
+#include "sharing_cost_model.h"
+#include "math.h"
+#include "logger.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace sel {
+
+namespace {
+
+constexpr auto YAO = BooleanSharing::YAO;
+constexpr auto GMW = BooleanSharing::GMW;
+
+// In order of preference on equal estimates
+constexpr array<SharingChoice, 4> Choices{{
+  {YAO, true}, {YAO, false}, {GMW, true}, {GMW, false}
+}};
+
+// Weight of a new measurement against the current coefficients
+constexpr double CalibrationRate = .5;
+
+double blend(double current, double measured) {
+  return (1. - CalibrationRate) * current + CalibrationRate * measured;
+}
+
+size_t fold_levels(size_t database_size) {
+  return ceil_log2(max(database_size, size_t{1}));
+}
+
+double transfer_ms(double bytes, const NetworkProfile& net) {
+  return bytes * 8. / (net.bandwidth_mbps * 1e3);
+}
+
+} // namespace
+
+SharingCostModel::SharingCostModel() :
+  // Yao sends garbled tables of 2x128 bits per AND gate and garbling is
+  // computationally expensive, while GMW needs a round per AND-depth. The
+  // conversion trades boolean multiplications for cheap arithmetic ones at the
+  // cost of the depth of the conversions.
+  coeffs{{
+    {200e3, 6., 2., .6}, // Yao, conversion
+    {320e3, 3., 0., 1.}, // Yao
+    {220e3, 200., 40., .08}, // GMW, conversion
+    {350e3, 250., 40., .1}, // GMW
+  }}
+{}
+
+size_t SharingCostModel::index(const SharingChoice& choice) {
+  return (choice.bool_sharing == GMW) * 2 + !choice.use_conversion;
+}
+
+double SharingCostModel::estimate_ms(const Coefficients& c, size_t num_records,
+    size_t database_size, const NetworkProfile& net) const {
+  const double pairs = num_records * database_size;
+  const double depth = c.depth_base + c.depth_per_level * fold_levels(database_size);
+  return transfer_ms(c.bytes_per_pair * pairs, net) + depth * net.rtt_ms
+    + c.ms_per_pair * pairs;
+}
+
+double SharingCostModel::estimate_ms(const SharingChoice& choice,
+    size_t num_records, size_t database_size, const NetworkProfile& net) const {
+  lock_guard<mutex> lock(mtx);
+  return estimate_ms(coeffs[index(choice)], num_records, database_size, net);
+}
+
+SharingChoice SharingCostModel::choose(size_t num_records,
+    size_t database_size, const NetworkProfile& net) const {
+  lock_guard<mutex> lock(mtx);
+  const auto logger = get_logger();
+  SharingChoice best = Choices[0];
+  double best_ms = estimate_ms(coeffs[index(best)], num_records, database_size, net);
+  for (const auto& choice : Choices) {
+    const auto ms = estimate_ms(coeffs[index(choice)], num_records, database_size, net);
+    logger->debug("Estimated runtime of {}: {:.1f}ms", choice, ms);
+    if (ms < best_ms) {
+      best = choice;
+      best_ms = ms;
+    }
+  }
+  logger->info("Chose {} for {}x{} records (rtt={}ms, bandwidth={}Mbit/s).",
+      best, num_records, database_size, net.rtt_ms, net.bandwidth_mbps);
+  return best;
+}
+
+void SharingCostModel::calibrate(const SharingChoice& choice, size_t num_records,
+    size_t database_size, const NetworkProfile& net, const RunCost& cost) {
+  const double pairs = num_records * database_size;
+  if (!pairs) return;
+
+  lock_guard<mutex> lock(mtx);
+  auto& c = coeffs[index(choice)];
+  c.bytes_per_pair = blend(c.bytes_per_pair, cost.bytes / pairs);
+  const size_t levels = fold_levels(database_size);
+  auto& last = last_depth[index(choice)];
+  if (last && last->levels != levels) {
+    const double slope = (cost.depth - last->depth)
+      / (static_cast<double>(levels) - static_cast<double>(last->levels));
+    c.depth_per_level = blend(c.depth_per_level, max(0., slope));
+  }
+  last = DepthSample{levels, static_cast<double>(cost.depth)};
+  c.depth_base = blend(c.depth_base, max(0.,
+        cost.depth - c.depth_per_level * levels));
+  const double network_ms = transfer_ms(cost.bytes, net) + cost.depth * net.rtt_ms;
+  c.ms_per_pair = blend(c.ms_per_pair, max(0., cost.time_ms - network_ms) / pairs);
+  get_logger()->debug("Calibrated {}: {} bytes/pair, {} + {}/level depth, "
+      "{}ms/pair", choice, c.bytes_per_pair, c.depth_base, c.depth_per_level,
+      c.ms_per_pair);
+}
+
+} /* end of namespace: sel */
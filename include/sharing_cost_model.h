@@ -0,0 +1,147 @@
+/**
+ \file    sharing_cost_model.h
+ \author  Sebastian Stammler <sebastian.stammler@cysec.de>
+ \copyright SEL - Secure EpiLinker
+      Copyright (C) 2018 Computational Biology & Simulation Group TU-Darmstadt
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+      GNU Affero General Public License for more details.
+      You should have received a copy of the GNU Affero General Public License
+      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief Cost model to choose the boolean sharing and conversion per job
+*/
+
+#ifndef SEL_SHARING_COST_MODEL_H
+#define SEL_SHARING_COST_MODEL_H
+#pragma once
+
+#include "circuit_config.h"
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace sel {
+
+struct SharingChoice {
+  BooleanSharing bool_sharing;
+  bool use_conversion;
+};
+
+/**
+ * Characteristics of the network link to a remote Secure EpiLinker
+ */
+struct NetworkProfile {
+  double rtt_ms = 1.;
+  double bandwidth_mbps = 1000.;
+};
+
+/**
+ * A choice of the cost model, together with the network profile it was made
+ * for, so that the model can be calibrated after the run.
+ */
+struct SharingDecision {
+  SharingChoice choice;
+  NetworkProfile net;
+};
+
+/**
+ * Communication and timing of a finished circuit run, as reported by ABY,
+ * summed over all circuits of a chunked run
+ */
+struct RunCost {
+  // Depth of the circuit, ABY's number of interactive layers. Each costs at
+  // most one round trip, but ABY does not report the actual rounds.
+  size_t depth;
+  uint64_t bytes; // sent and received during setup and online phase
+  double time_ms; // setup and online phase
+};
+
+/**
+ * Estimates the runtime of a linkage or counting job for all combinations of
+ * Yao/GMW sharing and arithmetic conversion, from the number of compared
+ * record pairs and the network profile:
+ *
+ *   time = bytes/bandwidth + depth*rtt + computation
+ *
+ * The depth is the number of interactive layers of the circuit. Each costs at
+ * most one round trip, so depth*rtt is an upper bound of the latency, which
+ * is all that ABY lets us measure. Yao only has a constant depth but more
+ * computation and communication per gate, while the depth of GMW grows with
+ * the max-fold over the database. So small jobs over high-latency links favor
+ * Yao and large jobs over fast links GMW.
+ *
+ * The coefficients start with rough estimates for a configuration of DKFZ size
+ * and are calibrated with the measured cost of each finished run. All methods
+ * are thread-safe.
+ */
+class SharingCostModel {
+public:
+  SharingCostModel();
+
+  /**
+   * Returns the choice of least estimated runtime. Deterministic for the same
+   * inputs and calibration state, ties resolve in the order Yao before GMW,
+   * conversion before none.
+   */
+  SharingChoice choose(size_t num_records, size_t database_size,
+      const NetworkProfile& net) const;
+
+  double estimate_ms(const SharingChoice& choice, size_t num_records,
+      size_t database_size, const NetworkProfile& net) const;
+
+  /**
+   * Updates the coefficients of the given choice from the cost of a run. The
+   * depth per fold level is fitted from the depth of consecutive runs over
+   * databases of different fold depth.
+   */
+  void calibrate(const SharingChoice& choice, size_t num_records,
+      size_t database_size, const NetworkProfile& net, const RunCost& cost);
+
+private:
+  struct Coefficients {
+    double bytes_per_pair; // communication per compared record pair
+    double depth_base; // circuit depth independent of the database size
+    double depth_per_level; // circuit depth per level of the max-fold
+    double ms_per_pair; // local computation per compared record pair
+  };
+
+  // Circuit depth of the last run of each choice over the given fold depth
+  struct DepthSample {
+    size_t levels;
+    double depth;
+  };
+
+  std::array<Coefficients, 4> coeffs;
+  std::array<std::optional<DepthSample>, 4> last_depth;
+  mutable std::mutex mtx;
+
+  static size_t index(const SharingChoice& choice);
+  double estimate_ms(const Coefficients& c, size_t num_records,
+      size_t database_size, const NetworkProfile& net) const;
+};
+
+} /* end of namespace: sel */
+
+namespace fmt {
+
+template <>
+struct formatter<sel::SharingChoice> {
+  template <typename ParseContext>
+  constexpr auto parse(ParseContext &ctx) { return ctx.begin(); }
+
+  template <typename FormatContext>
+  auto format(const sel::SharingChoice& c, FormatContext &ctx) {
+    return format_to(ctx.out(), "SharingChoice{{sharing={}, conversion={}}}",
+        c.bool_sharing, c.use_conversion);
+  }
+};
+
+} // namespace fmt
+
+#endif /* end of include guard: SEL_SHARING_COST_MODEL_H */
@@ -25,6 +25,7 @@
 #include <iomanip>
 #include <chrono>
 #include <random>
+#include <cassert>
 
 using namespace std;
 
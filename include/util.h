@@ -30,6 +30,8 @@
 #include <cctype>
 #include <locale>
 #include <sstream>
+#include <string_view>
+#include <type_traits>
 #include "fmt/format.h"
 
 using Bitmask = std::vector<uint8_t>;
@@ -164,6 +166,15 @@ std::vector<Key> map_keys(const std::map<Key, Value>& _map) {
   return keys;
 }
 
+template <class Key, class Value>
+std::vector<Value> map_values(const std::map<Key, Value>& _map) {
+  std::vector<Value> values;
+  values.reserve(_map.size());
+  for (const auto& kv : _map)
+    values.push_back(kv.second);
+  return values;
+}
+
 template <class Key, class Value>
 std::map<Key, std::vector<Value>>& append_to_map_of_vectors(
     const std::map<Key, std::vector<Value>>& source,
@@ -285,6 +296,17 @@ std::string generate_id();
 // https://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf#6089413
 std::istream& safeGetline(std::istream&, std::string&);
 
+/**
+ * Whether T can be iterated over
+ */
+template <typename T, typename = void>
+struct is_container : std::false_type {};
+
+template <typename T>
+struct is_container<T,
+    std::void_t<decltype(std::cbegin(std::declval<const T&>()))>>
+    : std::true_type {};
+
 } // namespace sel
 
 // Custom fmt formatters for our types
@@ -293,15 +315,21 @@ namespace fmt {
 /**
  * Container printer (vector, set, ...)
  * inspired by https://github.com/louisdx/cxx-prettyprint
+ * Only matches containers other than strings, so that it doesn't clash with
+ * the formatters of our other class templates and the string formatters of
+ * fmt 6 and newer.
  */
 template <typename T, template<typename...> class Container>
-struct formatter<Container<T>> {
+struct formatter<Container<T>, char, std::enable_if_t<
+    sel::is_container<Container<T>>::value &&
+    !std::is_same_v<Container<T>, basic_string_view<T>> &&
+    !std::is_convertible_v<Container<T>, std::string_view>>> {
   template <typename ParseContext>
   constexpr auto parse(ParseContext &ctx) { return ctx.begin(); }
 
   template <typename FormatContext>
   auto format(const Container<T> v, FormatContext &ctx) {
-    auto c = format_to(ctx.begin(), "[");
+    auto c = format_to(ctx.out(), "[");
 
     auto it = std::cbegin(v);
     auto the_end = std::cend(v);
@@ -321,7 +349,7 @@ template<> struct formatter<Bitmask> {
 
   template <typename FormatContext>
   auto format(const Bitmask v, FormatContext &ctx) {
-    auto c = ctx.begin();
+    auto c = ctx.out();
     for (auto e = v.cbegin(); e != v.cend(); ++e) {
       c = format_to(c, "{:x}", *e);
       // separate each 2 bytes by whitespace
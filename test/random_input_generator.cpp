@@ -86,19 +86,19 @@ EpilinkInput RandomInputGenerator::generate(const size_t database_size, const si
   EpilinkServerInput in_server {
     transform_map(cfg.fields,
       [this, &database_size, &num_records, &in_client](const FieldSpec& f)
-      -> VFieldEntry {
-        VFieldEntry ve;
+      -> FieldColumn {
+        FieldColumn ve{f.bitsize};
         ve.reserve(database_size);
         for (size_t i = 0; i < database_size; ++i) {
           if (random_empty(gen)) {
-            ve.emplace_back(nullopt);
+            ve.push_back(nullopt);
           } else if (f.comparator == FieldComparator::DICE) {
-            ve.emplace_back(random_bm(f.bitsize, bm_density_shift));
+            ve.push_back(random_bm(f.bitsize, bm_density_shift));
           } else if (random_match(gen)) {
             size_t match_idx = i % num_records;
-            ve.emplace_back(in_client.records->at(match_idx).at(f.name));
+            ve.push_back(in_client.records->at(match_idx).at(f.name));
           } else {
-            ve.emplace_back(random_bm(f.bitsize, 0));
+            ve.push_back(random_bm(f.bitsize, 0));
           }
         }
         return ve;
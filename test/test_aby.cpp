@@ -3,12 +3,16 @@
 #include "../include/aby/Share.h"
 #include "../include/aby/gadgets.h"
 #include "../include/aby/quotient_folder.hpp"
+#include "../include/aby/ranged_share.hpp"
+#include "../include/aby/gate_file.h"
+#include "../include/aby/int_div.h"
 #include "abycore/aby/abyparty.h"
 #include "abycore/sharing/sharing.h"
 #include "cxxopts.hpp"
 #include <numeric>
 #include <algorithm>
 #include <random>
+#include <chrono>
 #include <fmt/format.h>
 using fmt::print;
 
@@ -359,6 +363,222 @@ struct ABYTester {
     party.ExecCircuit();
   }
 
+  /**
+   * Folds nvals in segments of sizes 1, 2, 3, ... and prints the per-segment
+   * maxima, which must equal the locally computed ones.
+   */
+  template <class MultShare>
+  void test_segmented_quotient_folder() {
+    auto circ = circuit<MultShare>();
+    size_t num_bits = llround(2*((double)(bitlen)/3));
+    size_t den_bits = bitlen - num_bits;
+    auto data_num = make_random_vector(num_bits);
+    auto data_den = make_random_vector(den_bits);
+    print("numerators: {}\ndenominators: {}\n", data_num, data_den);
+
+    vector<size_t> segments;
+    for (size_t s = 1, left = nvals; left; ++s) {
+      segments.push_back(min(s, left));
+      left -= segments.back();
+    }
+    print("segments: {}\n", segments);
+
+    for (size_t s = 0, start = 0; s != segments.size(); start += segments[s++]) {
+      uint64_t max_num = 0, max_den = 1;
+      size_t max_idx = numeric_limits<size_t>::max();
+      for (size_t i = start; i < start + segments[s]; ++i) {
+        auto num = data_num[i], den = data_den[i];
+        if (den == 0) continue;
+        if ( (num * max_den > max_num * den)
+            or ( (num * max_den == max_num * den) and (den > max_den) )
+           ) {
+          max_den = den, max_num = num;
+          max_idx = i;
+        }
+      }
+      print("Segment {}: maximum num: {}, den: {}, index: {}\n",
+          s, max_num, max_den, max_idx);
+    }
+
+    Quotient<MultShare> inq = {
+      {circ, data_num.data(), bitlen, SERVER, nvals},
+      {circ, data_den.data(), bitlen, CLIENT, nvals}
+    };
+    vector<BoolShare> targets = {ascending_numbers_constant(bc, nvals)};
+
+    using QF = QuotientFolder<MultShare>;
+
+    QF folder(move(inq), QF::FoldOp::MAX_TIE, move(targets), move(segments));
+    if constexpr (std::is_same_v<MultShare, ArithShare>) {
+      folder.set_converters_and_den_bits(&to_bool_closure, &to_arith_closure, den_bits);
+    }
+    auto res = folder.fold();
+
+    print_share(res.get_selector().num, "max nums");
+    print_share(res.get_selector().den, "max dens");
+    print_share(res.get_targets()[0], "indices of max");
+
+    party.ExecCircuit();
+  }
+
+  /**
+   * Folds nblocks vertically combined blocks of nvals/nblocks values each
+   * element-wise and prints the per-position maxima, which must equal the
+   * locally computed ones.
+   */
+  template <class MultShare>
+  void test_blocked_quotient_folder(size_t nblocks = 3) {
+    auto circ = circuit<MultShare>();
+    size_t num_bits = llround(2*((double)(bitlen)/3));
+    size_t den_bits = bitlen - num_bits;
+    const size_t block_size = nvals/nblocks;
+    const size_t n = nblocks * block_size;
+    auto data_num = make_random_vector(num_bits);
+    auto data_den = make_random_vector(den_bits);
+    print("numerators: {}\ndenominators: {}\n", data_num, data_den);
+    print("{} blocks of size {}\n", nblocks, block_size);
+
+    for (size_t j = 0; j != block_size; ++j) {
+      uint64_t max_num = 0, max_den = 1;
+      size_t max_idx = numeric_limits<size_t>::max();
+      for (size_t i = j; i < n; i += block_size) {
+        auto num = data_num[i], den = data_den[i];
+        if (den == 0) continue;
+        if ( (num * max_den > max_num * den)
+            or ( (num * max_den == max_num * den) and (den > max_den) )
+           ) {
+          max_den = den, max_num = num;
+          max_idx = i;
+        }
+      }
+      print("Position {}: maximum num: {}, den: {}, index: {}\n",
+          j, max_num, max_den, max_idx);
+    }
+
+    Quotient<MultShare> inq = {
+      {circ, data_num.data(), bitlen, SERVER, (uint32_t)n},
+      {circ, data_den.data(), bitlen, CLIENT, (uint32_t)n}
+    };
+    vector<BoolShare> targets = {ascending_numbers_constant(bc, n)};
+
+    using QF = QuotientFolder<MultShare>;
+
+    QF folder(move(inq), QF::FoldOp::MAX_TIE, move(targets), {nblocks},
+        block_size);
+    if constexpr (std::is_same_v<MultShare, ArithShare>) {
+      folder.set_converters_and_den_bits(&to_bool_closure, &to_arith_closure, den_bits);
+    }
+    auto res = folder.fold();
+
+    print_share(res.get_selector().num, "max nums");
+    print_share(res.get_selector().den, "max dens");
+    print_share(res.get_targets()[0], "indices of max");
+
+    party.ExecCircuit();
+  }
+
+  /**
+   * Compares the circuit building time of integer division circuits read by
+   * ABY's PutGateFromFile() to those instantiated from the in-memory cache and
+   * those generated by int_div(). All results must be equal.
+   */
+  void bench_int_div_circuit(size_t reps = 300, size_t prec = 16) {
+    constexpr uint32_t div_bits = 10;
+    const auto fn = fmt::format("../data/circ/sel_int_div/{}_{}.aby",
+        div_bits, prec);
+    vector<uint32_t> data_x(nvals, 23), data_y(nvals, 42);
+    BoolShare x{bc, data_x.data(), div_bits, SERVER, nvals};
+    BoolShare y{bc, data_y.data(), div_bits, CLIENT, nvals};
+    vector<uint32_t> in = x.get()->get_wires();
+    const auto y_wires = y.get()->get_wires();
+    in.insert(in.end(), y_wires.cbegin(), y_wires.cend());
+
+    using Clock = chrono::steady_clock;
+    const auto time_builds = [reps](auto build) {
+      const auto start = Clock::now();
+      for (size_t i = 0; i != reps; ++i) build();
+      return chrono::duration<double, milli>{Clock::now() - start}.count();
+    };
+
+    vector<uint32_t> file_out, cache_out;
+    BoolShare size_out, depth_out;
+    const double file_time = time_builds([&]{
+        file_out = bc->PutGateFromFile(fn, in, nvals); });
+    const double cache_time = time_builds([&]{
+        cache_out = get_cached_gate_file(fn)->put_gates(bc, in, nvals); });
+    const double size_time = time_builds([&]{
+        size_out = int_div(x, y, div_bits, prec, DivisionOptimization::SIZE); });
+    const double depth_time = time_builds([&]{
+        depth_out = int_div(x, y, div_bits, prec, DivisionOptimization::DEPTH); });
+
+    const auto gf = get_cached_gate_file(fn);
+    print("{}: {} gates, {} non-linear, {} inputs, {} outputs\n", fn,
+        gf->num_gates(), gf->num_and_gates(), gf->num_inputs(), gf->num_outputs());
+    print("Building {} division circuits - PutGateFromFile: {:.1f}ms\n",
+        reps, file_time);
+    for (const auto& [name, time] : {make_pair("cached", cache_time),
+        make_pair("size-optimized", size_time),
+        make_pair("depth-optimized", depth_time)}) {
+      print("{}: {:.1f}ms, saves {:.1f}ms ({:.1f}x faster)\n",
+          name, time, file_time - time, file_time / time);
+    }
+
+    print_share(BoolShare{bc, file_out}, "23/42 from file");
+    print_share(BoolShare{bc, cache_out}, "23/42 from cache");
+    print_share(size_out, "23/42 size-optimized");
+    print_share(depth_out, "23/42 depth-optimized");
+
+    party.ExecCircuit();
+  }
+
+  /**
+   * Compares the generated integer division circuits to the given precomputed
+   * circuit file. All three results must be equal.
+   */
+  void test_int_div(size_t bits = 10, size_t prec = 16) {
+    const auto fn = fmt::format("../data/circ/sel_int_div/{}_{}.aby", bits, prec);
+    vector<uint32_t> data_x(nvals), data_y(nvals);
+    for (uint32_t i = 0; i != nvals; ++i) {
+      data_y[i] = 1 + (i * 37) % ((1u << bits) - 1);
+      data_x[i] = 1 + (i * 11) % data_y[i];
+    }
+    BoolShare x{bc, data_x.data(), (uint32_t)bits, SERVER, nvals};
+    BoolShare y{bc, data_y.data(), (uint32_t)bits, CLIENT, nvals};
+
+    const auto gf = get_cached_gate_file(fn);
+    const auto size_stats = int_div_stats(bits, prec, DivisionOptimization::SIZE);
+    const auto depth_stats = int_div_stats(bits, prec, DivisionOptimization::DEPTH);
+    print("Non-linear gates / depth of {}-bit division with precision {}:\n"
+        "file: {} / {}\nsize-optimized: {} / {}\ndepth-optimized: {} / {}\n",
+        bits, prec, gf->num_and_gates(), gf->and_depth(),
+        size_stats.and_gates, size_stats.and_depth,
+        depth_stats.and_gates, depth_stats.and_depth);
+
+    print_share(apply_file_binary(x, y, bits, bits, fn), "x/y from file");
+    print_share(int_div(x, y, bits, prec, DivisionOptimization::SIZE),
+        "x/y size-optimized");
+    print_share(int_div(x, y, bits, prec, DivisionOptimization::DEPTH),
+        "x/y depth-optimized");
+
+    party.ExecCircuit();
+  }
+
+  void test_arith_mux() {
+    vector<uint32_t> va(nvals), vb(nvals), vsel(nvals);
+    for (uint32_t i = 0; i != nvals; ++i) {
+      va[i] = 1000 + i;
+      vb[i] = 7 * i;
+      vsel[i] = i % 2;
+    }
+    ArithShare a{ac, va.data(), bitlen, SERVER, nvals};
+    ArithShare b{ac, vb.data(), bitlen, CLIENT, nvals};
+    BoolShare sel{bc, vsel.data(), 1, SERVER, nvals};
+
+    ArithQuotient q = mux(to_arith(sel), ArithQuotient{a, b}, ArithQuotient{b, a});
+    print_share(q, "sel ? (a, b) : (b, a)");
+
+    party.ExecCircuit();
+  }
 
   void test_add() {
     constexpr uint32_t _bitlen = 8;
@@ -379,6 +599,50 @@ struct ABYTester {
 
     cout << "a+b: " << out_ab.get_clear_value<uint32_t>() << endl;
   }
+
+  /**
+   * Products and sums of narrow ranged shares must not lose any carry, while
+   * their shares only get as wide as the values need.
+   */
+  void test_ranged_share(size_t a_bits = 7, size_t b_bits = 5) {
+    auto data_a = make_random_vector(a_bits);
+    auto data_b = make_random_vector(b_bits);
+    vector<uint64_t> data_bit(nvals);
+    for (size_t i = 0; i != nvals; ++i) data_bit[i] = i % 2;
+    Ranged<BoolShare> a{BoolShare{bc, data_a.data(), (uint32_t)a_bits, SERVER, nvals},
+      a_bits, bitlen};
+    Ranged<BoolShare> b{BoolShare{bc, data_b.data(), (uint32_t)b_bits, CLIENT, nvals},
+      b_bits, bitlen};
+    Ranged<BoolShare> bit{BoolShare{bc, data_bit.data(), 1, SERVER, nvals}, 1, bitlen};
+
+    const auto ab = a * b;
+    const auto a_plus_b = a + b;
+    const auto a_bit = a * bit;
+    const auto abs = sum(vector<Ranged<BoolShare>>{ab, a, b});
+    print("bits a*b: {}, a+b: {}, a*bit: {}, a*b+a+b: {}\n",
+        ab.get().get_bitlen(), a_plus_b.get().get_bitlen(),
+        a_bit.get().get_bitlen(), abs.get().get_bitlen());
+
+    auto out_ab = out(ab.get(), ALL);
+    auto out_a_plus_b = out(a_plus_b.get(), ALL);
+    auto out_a_bit = out(a_bit.get(), ALL);
+    auto out_abs = out(abs.get(), ALL);
+
+    party.ExecCircuit();
+
+    auto v_ab = out_ab.get_clear_value_vec();
+    auto v_a_plus_b = out_a_plus_b.get_clear_value_vec();
+    auto v_a_bit = out_a_bit.get_clear_value_vec();
+    auto v_abs = out_abs.get_clear_value_vec();
+    for (size_t i = 0; i != nvals; ++i) {
+      assert (v_ab[i] == data_a[i] * data_b[i]);
+      assert (v_a_plus_b[i] == data_a[i] + data_b[i]);
+      assert (v_a_bit[i] == data_a[i] * data_bit[i]);
+      assert (v_abs[i] == data_a[i] * data_b[i] + data_a[i] + data_b[i]);
+    }
+    print("a*b: {}\na+b: {}\na*bit: {}\na*b+a+b: {}\n",
+        v_ab, v_a_plus_b, v_a_bit, v_abs);
+  }
 };
 
 int main(int argc, char *argv[])
@@ -413,6 +677,7 @@ int main(int argc, char *argv[])
 
   //tester.test_split_select_target();
   //tester.test_add();
+  //tester.test_ranged_share();
   //tester.test_mult_const();
   //tester.test_hw();
   //tester.test_max_bits();
@@ -420,6 +685,11 @@ int main(int argc, char *argv[])
   //tester.test_reinterpret();
   //tester.test_split_accumulate();
   tester.test_quotient_folder<BoolShare>();
+  //tester.test_segmented_quotient_folder<BoolShare>();
+  //tester.test_blocked_quotient_folder<BoolShare>();
+  //tester.bench_int_div_circuit();
+  //tester.test_int_div();
+  //tester.test_arith_mux();
   //tester.test_max_quotient();
   //tester.test_bm_input();
   //tester.test_deterministic_aby_chaos();
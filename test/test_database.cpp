@@ -0,0 +1,453 @@
+#include "../include/field_column.h"
+#include "../include/serverdata.h"
+#include "../include/pageparser.h"
+#include "../include/jsonutils.h"
+#include "../include/databasesnapshot.h"
+#include "../include/databasecache.h"
+#include "../include/logger.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sel {
+
+template <class Exception, class F>
+bool throws(F f) {
+  try {
+    f();
+  } catch (const Exception&) {
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Column of 12 bit entries, every third one empty
+ */
+FieldColumn make_column(size_t size) {
+  FieldColumn c{12};
+  for (size_t i = 0; i != size; ++i) {
+    if (i % 3) c.push_back(Bitmask{uint8_t(i), uint8_t(i % 16)});
+    else c.push_back(nullopt);
+  }
+  return c;
+}
+
+void test_field_column_entries() {
+  const auto c = make_column(70);
+  assert (c.size() == 70);
+  assert (c.bytesize() == 2);
+  for (size_t i = 0; i != c.size(); ++i) {
+    assert (c.has_value(i) == bool(i % 3));
+    if (c.has_value(i)) {
+      const Bitmask expected{uint8_t(i), uint8_t(i % 16)};
+      assert (c[i] == expected);
+      assert (c.hw(i) == hw(expected));
+    } else {
+      assert (!c[i]);
+      assert (c.value(i)[0] == 0 && c.value(i)[1] == 0);
+      assert (c.hw(i) == 0);
+    }
+  }
+
+  FieldColumn d{12};
+  assert (throws<invalid_argument>([&]{ d.push_back(Bitmask{1}); }));
+  assert (throws<invalid_argument>([]{ FieldColumn{1u << 16}; }));
+}
+
+void test_field_column_copy_on_write() {
+  const auto c = make_column(10);
+  auto copy = c;
+  assert (copy.data() == c.data());
+  copy.set(1, nullopt);
+  assert (copy.data() != c.data());
+  assert (!copy.has_value(1) && c.has_value(1));
+  assert (copy.hw(1) == 0 && c.hw(1) != 0);
+
+  // An exclusively owned column is written in place
+  const auto* data = copy.data();
+  copy.set(2, Bitmask{0xff, 0x0f});
+  assert (copy.data() == data);
+  assert (copy.hw(2) == 12);
+
+  assert (throws<out_of_range>([&]{ copy.set(10, nullopt); }));
+  assert (throws<invalid_argument>([&]{ copy.set(0, Bitmask{1, 2, 3}); }));
+}
+
+void test_field_column_slices() {
+  auto c = make_column(100);
+  const auto s = c.slice(65, 30);
+  assert (s.size() == 30);
+  assert (s.data() == c.data() + 65 * c.bytesize());
+  for (size_t i = 0; i != s.size(); ++i) assert (s[i] == c[65 + i]);
+  assert (s.slice(5, 10) == c.slice(70, 10));
+  assert (throws<out_of_range>([&]{ c.slice(90, 11); }));
+
+  // Writing to the column leaves the slice untouched and vice versa
+  c.set(67, nullopt);
+  assert (!c.has_value(67) && s.has_value(2));
+  auto t = s;
+  t.push_back(Bitmask{1, 1});
+  assert (t.size() == 31 && s.size() == 30);
+  assert (t.slice(0, 30) == s);
+  assert (c.size() == 100);
+}
+
+void test_field_column_append() {
+  auto c = make_column(40);
+  const auto original = c;
+  // Appends across the 64 entry boundary of the validity bitmap
+  c.append(c);
+  assert (c.size() == 80);
+  assert (c.slice(0, 40) == original && c.slice(40, 40) == original);
+
+  c.append(c.slice(10, 5));
+  assert (c.size() == 85);
+  assert (c.slice(80, 5) == original.slice(10, 5));
+
+  FieldColumn empty;
+  empty.append(original);
+  assert (empty == original);
+
+  assert (throws<invalid_argument>([&]{ c.append(FieldColumn{8}); }));
+}
+
+void test_field_column_equality() {
+  const auto c = make_column(20);
+  assert (c == make_column(20));
+  assert (c != make_column(21));
+  assert (c.slice(0, 0) == FieldColumn{12});
+  assert (FieldColumn{12} != FieldColumn{13});
+
+  // Empty entries and zero values have the same packed value
+  auto zero = c;
+  zero.set(0, Bitmask{0, 0});
+  assert (zero != c);
+}
+
+ServerData make_server_data(const vector<string>& ids,
+    const vector<optional<Bitmask>>& entries, ToDate todate) {
+  ServerData data;
+  data.data = make_shared<VRecord>();
+  data.data->emplace("f", FieldColumn{12, entries});
+  data.ids = make_shared<vector<string>>(ids);
+  data.todate = todate;
+  return data;
+}
+
+void test_merge_database_diff() {
+  auto cached = make_server_data({"a", "b", "c"},
+      {Bitmask{1, 0}, Bitmask{2, 0}, Bitmask{3, 0}}, 10);
+  cached.full_sync_time = chrono::system_clock::time_point{chrono::hours{1}};
+  const auto cached_column = cached.data->at("f");
+
+  // Updates b, empties c and appends d
+  auto diff = make_server_data({"b", "c", "d"},
+      {Bitmask{4, 0}, nullopt, Bitmask{5, 0}}, 20);
+  const auto merged = merge_database_diff(cached, move(diff));
+
+  assert ((*merged.ids == vector<string>{"a", "b", "c", "d"}));
+  const FieldColumn expected{12,
+    {Bitmask{1, 0}, Bitmask{4, 0}, nullopt, Bitmask{5, 0}}};
+  assert (merged.data->at("f") == expected);
+  assert (merged.todate == 20);
+  assert (merged.full_sync_time == cached.full_sync_time);
+  // The cached database is left untouched
+  assert (cached.data->at("f") == cached_column);
+  assert (cached.ids->size() == 3);
+
+  // Records changed again keep their index
+  auto diff2 = make_server_data({"d", "a"}, {nullopt, Bitmask{6, 0}}, 30);
+  const auto merged2 = merge_database_diff(merged, move(diff2));
+  assert (*merged2.ids == *merged.ids);
+  const FieldColumn expected2{12,
+    {Bitmask{6, 0}, Bitmask{4, 0}, nullopt, nullopt}};
+  assert (merged2.data->at("f") == expected2);
+}
+
+map<FieldName, FieldSpec> make_page_fields() {
+  return {
+    {"name", {"name", 1., FieldComparator::DICE, FieldType::STRING, 40}},
+    {"year", {"year", 1., FieldComparator::BINARY, FieldType::INTEGER, 13}},
+    {"weight", {"weight", 1., FieldComparator::BINARY, FieldType::NUMBER, 64}},
+    {"bloom", {"bloom", 1., FieldComparator::DICE, FieldType::BITMASK, 20}}
+  };
+}
+
+string make_page(const string& records) {
+  return R"({"localId": "l", "remoteId": "r", "toDate": 1234,
+    "lastPageNumber": 3, "_links": {"next": {"href": "next?page=2"}},
+    "records": [)" + records + "]}";
+}
+
+const string page_records{R"(
+  {"id": "1", "fields": {"name": "Anna", "year": 1980, "weight": 61.5,
+    "bloom": "/w8P"}},
+  {"fields": {"year": null, "name": " ", "weight": 72, "bloom": ""},
+    "id": "2"},
+  {"id": "3", "fields": {"bloom": "AAAA", "weight": null, "year": -3,
+    "name": "Bartholomew"}})"};
+
+/**
+ * Parses the page with the PageParser and returns its columns and ids
+ */
+pair<VRecord, vector<string>> parse_page(const string& page) {
+  static const auto page_fields = make_page_fields();
+  VRecord records;
+  vector<string> ids;
+  PageParser parser{page_fields, records, &ids, 2};
+  parser.parse(page);
+  assert (parser.num_records() == ids.size());
+  return {move(records), move(ids)};
+}
+
+void test_database_cache() {
+  mutex fetch_mutex;
+  size_t full_polls{0};
+  vector<ToDate> diff_polls;
+  const auto fetch = [&](const RemoteId&, optional<ToDate> from_date) {
+    lock_guard<mutex> lock(fetch_mutex);
+    if (!from_date) {
+      ++full_polls;
+      return make_server_data({"a", "b"}, {Bitmask{1, 0}, Bitmask{2, 0}}, 10);
+    }
+    diff_polls.push_back(*from_date);
+    return make_server_data({}, {}, *from_date + 1);
+  };
+
+  {
+    // A matching request and then a linkage request share the refreshed
+    // database, which both need with ids
+    DatabaseCache cache{[]{
+      return DatabaseCache::Policy{chrono::hours{1}}; }, fetch};
+    cache.start_refresher("remote");
+    const auto matching = cache.get_current_database("remote");
+    const auto linkage = cache.get_current_database("remote");
+    assert (matching && matching->ids && matching->ids->size() == 2);
+    assert (linkage && linkage->ids && *linkage->ids == *matching->ids);
+    assert (linkage->prepared->version == 0);
+  }
+  assert (full_polls == 1);
+
+  // Without refresher, each request polls the changes since the last one
+  full_polls = 0;
+  diff_polls.clear();
+  DatabaseCache cache{[]{ return DatabaseCache::Policy{}; }, fetch};
+  assert (cache.get_current_database("remote")->todate == 10);
+  const auto current = cache.get_current_database("remote");
+  assert (full_polls == 1 && (diff_polls == vector<ToDate>{10}));
+  assert (current->todate == 11 && current->ids->size() == 2);
+  assert (current->prepared->version == 0);
+
+  // Databases without ids are never cached
+  DatabaseCache no_ids{[]{ return DatabaseCache::Policy{}; },
+    [](const RemoteId&, optional<ToDate>) {
+      auto data = make_server_data({"a"}, {Bitmask{1, 0}}, 10);
+      data.ids = nullptr;
+      return data;
+    }};
+  assert (throws<runtime_error>([&]{
+        no_ids.get_current_database("remote"); }));
+  assert (!no_ids.get_database("remote"));
+}
+
+void test_page_parser() {
+  const auto page_fields = make_page_fields();
+  const auto page = make_page(page_records);
+  const auto json = nlohmann::json::parse(page);
+  const auto dom_records = parse_json_fields_array(page_fields,
+      json.at("records"));
+  const auto dom_ids = parse_json_id_array(json.at("records"));
+
+  VRecord records;
+  vector<string> ids;
+  PageParser parser{page_fields, records, &ids};
+  parser.parse(page);
+  assert (records == dom_records);
+  assert (ids == dom_ids);
+  assert ((ids == vector<string>{"1", "2", "3"}));
+  assert (!records.at("name")[1] && !records.at("bloom")[1]);
+  assert (records.at("bloom")[0] == (Bitmask{0xff, 0x0f, 0x0f}));
+  assert (parser.num_records() == 3);
+  assert (parser.has_links() && parser.has_records());
+  assert (parser.todate() == ToDate{1234});
+  assert (parser.last_page() == 3u);
+  assert (parser.local_id() == "l" && parser.remote_id() == "r");
+  assert (parser.next_page() == "next?page=2");
+
+  // The first page comes wrapped in an array
+  assert (parse_page("[" + page + "]") == make_pair(dom_records, dom_ids));
+
+  // Following pages are appended
+  parser.parse(page);
+  assert (records.at("name").size() == 6 && ids.size() == 6);
+  assert (records.at("year").slice(3, 3) == dom_records.at("year"));
+}
+
+void test_page_parser_invalid() {
+  const auto invalid = [](const string& record) {
+    return throws<runtime_error>([&]{ parse_page(make_page(record)); });
+  };
+  const string fields{R"("name": "A", "year": 1, "weight": 1.5, "bloom": "")"};
+  assert (!invalid(R"({"id": "1", "fields": {)" + fields + "}}"));
+  // Missing field
+  assert (invalid(R"({"id": "1", "fields": {"name": "A", "year": 1,
+      "weight": 1.5}})"));
+  // Duplicate field
+  assert (invalid(R"({"id": "1", "fields": {"name": "B", )" + fields + "}}"));
+  // Unknown field
+  assert (invalid(R"({"id": "1", "fields": {"x": 1, )" + fields + "}}"));
+  // Missing id and fields
+  assert (invalid(R"({"fields": {)" + fields + "}}"));
+  assert (invalid(R"({"id": "1"})"));
+  // Wrong value types, like the DOM parser
+  assert (invalid(R"({"id": "1", "fields": {"name": 1, "year": 1,
+      "weight": 1.5, "bloom": ""}})"));
+  assert (invalid(R"({"id": "1", "fields": {"name": "A", "year": "1",
+      "weight": 1.5, "bloom": ""}})"));
+  assert (invalid(R"({"id": "1", "fields": {"name": "A", "year": true,
+      "weight": 1.5, "bloom": ""}})"));
+  const auto year = make_page_fields().at("year");
+  assert (throws<runtime_error>([&]{
+      parse_json_field(year, nlohmann::json(true)); }));
+  // Malformed JSON
+  assert (throws<runtime_error>([&]{ parse_page(make_page("{")); }));
+}
+
+void test_database_snapshot() {
+  auto fields = make_page_fields();
+  fields.erase("name");
+  fields.erase("weight");
+  fields.at("year").bitsize = 12;
+  // Slices of columns with offsets off the validity words
+  ServerData data;
+  data.data = make_shared<VRecord>();
+  data.data->emplace("year", make_column(200).slice(7, 150));
+  FieldColumn bloom{20};
+  for (size_t i = 0; i != 200; ++i) {
+    if (i % 5) bloom.push_back(Bitmask{1, 2, uint8_t(i % 16)});
+    else bloom.push_back(nullopt);
+  }
+  data.data->emplace("bloom", bloom.slice(7, 150));
+  data.ids = make_shared<vector<string>>();
+  for (size_t i = 0; i != 150; ++i) data.ids->emplace_back(to_string(i));
+  data.todate = 42;
+  data.local_id = "local";
+  data.remote_id = "remote";
+  data.full_sync_time = chrono::system_clock::time_point{chrono::hours{1}};
+
+  const auto file = filesystem::temp_directory_path() / "test_database.snapshot";
+  write_database_snapshot(data, fields, file);
+  assert (!filesystem::exists(file.string() + ".tmp"));
+  {
+    const auto mapped = map_database_snapshot(file, fields);
+    assert (*mapped.data == *data.data);
+    assert (*mapped.ids == *data.ids);
+    assert (mapped.todate == 42);
+    assert (mapped.local_id == "local" && mapped.remote_id == "remote");
+    assert (mapped.full_sync_time == data.full_sync_time);
+    assert (mapped.fetch_time == chrono::steady_clock::time_point{});
+
+    // Writes copy the mapped column first
+    auto year = mapped.data->at("year");
+    year.set(1, nullopt);
+    year.push_back(Bitmask{1, 1});
+    assert (!year.has_value(1) && mapped.data->at("year").has_value(1));
+    assert (year.size() == 151 && mapped.data->at("year").size() == 150);
+    assert (year.slice(2, 148) == data.data->at("year").slice(2, 148));
+  }
+
+  // Counting mode databases have no ids
+  auto no_ids = data;
+  no_ids.ids = nullptr;
+  write_database_snapshot(no_ids, fields, file);
+  assert (!map_database_snapshot(file, fields).ids);
+  write_database_snapshot(data, fields, file);
+
+  const auto rejected = [&](const map<FieldName, FieldSpec>& f) {
+    return throws<runtime_error>([&]{ map_database_snapshot(file, f); });
+  };
+  assert (!rejected(fields));
+  auto changed = fields;
+  changed.at("year").bitsize = 13;
+  assert (rejected(changed));
+  changed = fields;
+  changed.at("year").type = FieldType::NUMBER;
+  assert (rejected(changed));
+  changed = fields;
+  changed.at("bloom").comparator = FieldComparator::BINARY;
+  assert (rejected(changed));
+  changed = fields;
+  changed.erase("bloom");
+  assert (rejected(changed));
+  assert (throws<invalid_argument>([&]{
+        write_database_snapshot(data, changed, file); }));
+
+  // Truncated and corrupt files
+  const auto size = filesystem::file_size(file);
+  for (const auto truncated_size : {size - 1, size / 2, size_t{20}}) {
+    write_database_snapshot(data, fields, file);
+    filesystem::resize_file(file, truncated_size);
+    assert (rejected(fields));
+  }
+  write_database_snapshot(data, fields, file);
+  {
+    // Claims far more records than the file holds
+    fstream f{file, ios::in | ios::out | ios::binary};
+    f.seekp(32);
+    const uint64_t num_records = uint64_t{1} << 62;
+    f.write(reinterpret_cast<const char*>(&num_records), sizeof(num_records));
+  }
+  assert (rejected(fields));
+  {
+    // Renames the second of two equally configured fields to the first
+    auto twice = fields;
+    twice.erase("bloom");
+    twice.emplace("yea2", twice.at("year"));
+    auto dup = data;
+    dup.data = make_shared<VRecord>();
+    dup.data->emplace("year", data.data->at("year"));
+    dup.data->emplace("yea2", data.data->at("year"));
+    write_database_snapshot(dup, twice, file);
+    string bytes;
+    {
+      ifstream f{file, ios::binary};
+      bytes.assign(istreambuf_iterator<char>{f}, {});
+    }
+    bytes.replace(bytes.find("yea2"), 4, "year");
+    ofstream{file, ios::binary | ios::trunc} << bytes;
+    assert (rejected(twice));
+  }
+  {
+    ofstream f{file, ios::binary | ios::trunc};
+    f << "no snapshot";
+  }
+  assert (rejected(fields));
+  filesystem::remove(file);
+  assert (rejected(fields));
+}
+
+} // namespace sel
+
+using namespace sel;
+
+int main()
+{
+  create_terminal_logger();
+  spdlog::set_level(spdlog::level::err);
+  test_field_column_entries();
+  test_field_column_copy_on_write();
+  test_field_column_slices();
+  test_field_column_append();
+  test_field_column_equality();
+  test_merge_database_diff();
+  test_database_cache();
+  test_page_parser();
+  test_page_parser_invalid();
+  test_database_snapshot();
+  return 0;
+}
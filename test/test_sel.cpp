@@ -1,12 +1,17 @@
 #include "cxxopts.hpp"
 #include "fmt/format.h"
 #include "abycore/aby/abyparty.h"
+#include "abycore/circuit/arithmeticcircuits.h"
+#include "abycore/circuit/booleancircuits.h"
+#include "abycore/sharing/sharing.h"
 
 #include "../include/logger.h"
 #include "../include/util.h"
 #include "../include/jsonutils.h"
 #include "../include/secure_epilinker.h"
+#include "../include/circuit_builder.h"
 #include "../include/clear_epilinker.h"
+#include "../include/linkage_plan.h"
 #include "random_input_generator.h"
 
 #include <filesystem>
@@ -27,6 +32,11 @@ bool only_local{false};
 MPCRole role;
 BooleanSharing sharing;
 bool use_conversion{false};
+bool batch_records{false};
+size_t chunk_size{0};
+size_t max_exchanged_fields{0};
+bool use_int_div_files{false};
+size_t word_size{BitLen};
 bool print_table{false};
 int bitmask_density_shift{0};
 
@@ -151,7 +161,7 @@ EpilinkInput input_simple(uint32_t dbsize) {
   };
 
   EpilinkServerInput in_server {
-    { {"int_1", vector<FieldEntry>(dbsize, data_int_1)} }, // db
+    { {"int_1", FieldColumn{f_int1.bitsize, vector<FieldEntry>(dbsize, data_int_1)}} }, // db
     1 // num_records
   };
 
@@ -175,7 +185,8 @@ EpilinkInput input_simple_bm(uint32_t dbsize) {
   };
 
   EpilinkServerInput in_server {
-    { {"bm_1", vector<FieldEntry>(dbsize, Bitmask{0b11101110})} }, // db
+    { {"bm_1", FieldColumn{td["bm_1"].field.bitsize,
+      vector<FieldEntry>(dbsize, Bitmask{0b11101110})}} }, // db
     1 // num_records
   };
 
@@ -215,10 +226,10 @@ EpilinkInput input_exchange_grp(uint32_t dbsize) {
 
   EpilinkServerInput in_server {
     {
-      {"bm_1", vector<FieldEntry>(dbsize, Bitmask{0x44})}, // 2-bit mismatch
-      {"bm_2", vector<FieldEntry>(dbsize, Bitmask{0x35})}, // 1-bit mismatch
-      {"int_1", vector<FieldEntry>(dbsize, data_int_1)},
-      {"int_2", vector<FieldEntry>(dbsize, data_int_2)}
+      {"bm_1", FieldColumn{f_bm1.bitsize, vector<FieldEntry>(dbsize, Bitmask{0x44})}}, // 2-bit mismatch
+      {"bm_2", FieldColumn{f_bm2.bitsize, vector<FieldEntry>(dbsize, Bitmask{0x35})}}, // 1-bit mismatch
+      {"int_1", FieldColumn{f_int1.bitsize, vector<FieldEntry>(dbsize, data_int_1)}},
+      {"int_2", FieldColumn{f_int2.bitsize, vector<FieldEntry>(dbsize, data_int_2)}}
     }, // db
     1 // num_records
   };
@@ -251,8 +262,8 @@ EpilinkInput input_empty() {
 
   EpilinkServerInput in_server {
     {
-      {"bm_1", { nullopt, Bitmask{0x31} }}, // 1-bit mismatch for #1
-      {"bm_2", { Bitmask{0x43}, Bitmask{0x44} }}, // 2-bit mismatch for #0
+      {"bm_1", FieldColumn{f_bm1.bitsize, { nullopt, Bitmask{0x31} }}}, // 1-bit mismatch for #1
+      {"bm_2", FieldColumn{f_bm2.bitsize, { Bitmask{0x43}, Bitmask{0x44} }}}, // 2-bit mismatch for #0
     }, // db
     1 // num_records
   };
@@ -297,7 +308,7 @@ auto read_database_dir(const fs::path& dir_path, const EpilinkConfig& epi_cfg) {
   for (auto& f: fs::directory_iterator(dir_path)) {
     if (f.path().extension() == ".json") {
       auto temp_db = read_database_file(f, epi_cfg);
-      append_to_map_of_vectors(temp_db, db);
+      append_columns(temp_db, db);
     }
   }
   return db;
@@ -390,24 +401,34 @@ auto run_sel_count(SecureEpilinker& linker, const EpilinkInput& in) {
   return res;
 }
 
+CircuitConfig make_circuit_config(const EpilinkConfig& cfg, size_t bitlen) {
+  CircuitConfig circ_cfg{cfg, CircDir, true, sharing, use_conversion, bitlen};
+  circ_cfg.batch_records = batch_records;
+  circ_cfg.chunk_size = chunk_size;
+  circ_cfg.max_exchanged_fields = max_exchanged_fields;
+  circ_cfg.use_int_div_files = use_int_div_files;
+  return circ_cfg;
+}
+
+/**
+ * Local calculations on integral types use the type's bitlength, all others
+ * the word size of the secure circuit.
+ */
 template <typename T>
-CircuitConfig make_circuit_config(const EpilinkConfig& cfg) {
-  size_t bitlen = BitLen;
-  if constexpr (is_integral_v<T>) {
-    bitlen = sizeof(T)*8;
-  }
-  return {cfg, CircDir, true, sharing, use_conversion, bitlen};
+size_t local_bitlen() {
+  if constexpr (is_integral_v<T>) return sizeof(T)*8;
+  else return word_size;
 }
 
 template <typename T>
-auto run_local_linkage(const EpilinkInput& in) {
-  const auto circ_cfg = make_circuit_config<T>(in.cfg);
+auto run_local_linkage(const EpilinkInput& in, size_t bitlen = local_bitlen<T>()) {
+  const auto circ_cfg = make_circuit_config(in.cfg, bitlen);
   return clear_epilink::calc<T>(*in.client.records, *in.server.database, circ_cfg);
 }
 
 template <typename T>
 auto run_local_count(const EpilinkInput& in) {
-  const auto circ_cfg = make_circuit_config<T>(in.cfg);
+  const auto circ_cfg = make_circuit_config(in.cfg, local_bitlen<T>());
   return clear_epilink::calc_count<T>(*in.client.records, *in.server.database, circ_cfg);
 }
 
@@ -436,6 +457,8 @@ string test_str(bool test) {
 bool run_and_print_linkage(SecureEpilinker& linker, const EpilinkInput& in) {
   vector<Result<CircUnit>> results;
   if (!only_local) results = run_sel_linkage(linker, in);
+  // Same precisions as the secure circuit, to compare against
+  const auto results_word = run_local_linkage<CircUnit>(in, word_size);
   const auto results_32 = run_local_linkage<uint32_t>(in);
   const auto results_64 = run_local_linkage<uint64_t>(in);
   const auto results_double = run_local_linkage<double>(in);
@@ -451,7 +474,7 @@ bool run_and_print_linkage(SecureEpilinker& linker, const EpilinkInput& in) {
 #ifdef DEBUG_SEL_RESULT
     if (!only_local) {
       resp = &results[i];
-      bool correct = *resp == results_32[i];
+      bool correct = *resp == results_word[i];
       all_good &= correct;
       print(outputss, "------ Secure Epilinker -------\n{} {}\n", *resp, test_str(correct));
     }
@@ -522,6 +545,74 @@ void run_and_print_score_table(const EpilinkInput& in) {
   }
 }
 
+struct CircuitSize {
+  uint32_t and_gates, mul_gates, total_gates, depth;
+};
+
+/**
+ * Size of the linkage circuit of a single record and database entry, whose
+ * only fields are an exchange group of given size of DKFZ-like name bitmasks.
+ * It is built locally as server, without connecting to a client or executing
+ * it. Besides the exchange group, it contains the constant score
+ * classification.
+ */
+CircuitSize exchange_group_circuit_size(size_t size, size_t max_exchanged) {
+  map<FieldName, FieldSpec> fields;
+  IndexSet group;
+  VRecord database;
+  for (size_t i = 0; i != size; ++i) {
+    const auto name = "name" + to_string(i);
+    fields.emplace(name, FieldSpec(name, 0.000235, 0.01, "dice", "bitmask", 500));
+    group.insert(name);
+    database.emplace(name, FieldColumn{500, {Bitmask(bitbytes(500), 0x55)}});
+  }
+  auto circ_cfg = make_circuit_config({fields, {group}, Threshold, TThreshold},
+      word_size);
+  circ_cfg.max_exchanged_fields = max_exchanged;
+
+  ABYParty party{SERVER, "127.0.0.1", 5676, LT, (uint32_t)circ_cfg.bitlen, 1};
+  const auto sharings = party.GetSharings();
+  const auto bool_sharing = (sharing == BooleanSharing::YAO) ? S_YAO : S_BOOL;
+  const auto conv_sharing = (sharing == BooleanSharing::YAO) ? S_BOOL : S_YAO;
+  auto bc = dynamic_cast<BooleanCircuit*>(
+      sharings[bool_sharing]->GetCircuitBuildRoutine());
+  auto cc = dynamic_cast<BooleanCircuit*>(
+      sharings[conv_sharing]->GetCircuitBuildRoutine());
+  auto ac = dynamic_cast<ArithmeticCircuit*>(
+      sharings[S_ARITH]->GetCircuitBuildRoutine());
+  auto builder = make_unique_circuit_builder(circ_cfg, bc, cc, ac);
+  builder->set_input(EpilinkServerInput{database, 1});
+  builder->build_linkage_circuit();
+  return {bc->GetNumANDGates() + cc->GetNumANDGates(), ac->GetNumMULGates(),
+    party.GetTotalGates(), party.GetTotalDepth()};
+}
+
+/**
+ * Prints the cost of exchange groups up to the given size as CSV, for all
+ * permutations and those exchanging at most max_exchanged_fields fields: the
+ * permutations and comparisons of the LinkagePlan and the AND gates (of both
+ * boolean sharings), arithmetic multiplications, total gates and depth of
+ * the circuit built with the selected sharing and conversion.
+ */
+void print_exchange_group_costs(size_t max_size) {
+  print("size;permutations;comparisons;and_gates;mul_gates;gates;depth;"
+      "bounded_permutations;bounded_comparisons;bounded_and_gates;"
+      "bounded_mul_gates;bounded_gates;bounded_depth\n");
+  for (size_t size = 2; size <= max_size; ++size) {
+    const auto full = LinkagePlan::exchange_group_cost(size);
+    const auto bounded = LinkagePlan::exchange_group_cost(size,
+        max_exchanged_fields);
+    const auto full_circ = exchange_group_circuit_size(size, 0);
+    const auto bounded_circ = exchange_group_circuit_size(size,
+        max_exchanged_fields);
+    print("{};{};{};{};{};{};{};{};{};{};{};{};{}\n", size,
+        full.permutations, full.comparisons, full_circ.and_gates,
+        full_circ.mul_gates, full_circ.total_gates, full_circ.depth,
+        bounded.permutations, bounded.comparisons, bounded_circ.and_gates,
+        bounded_circ.mul_gates, bounded_circ.total_gates, bounded_circ.depth);
+  }
+}
+
 template <typename T>
 void print_toml(ostream& out, string field, T value) {
   print(out, "{} = {}\n", field, value);
@@ -543,6 +634,7 @@ int main(int argc, char *argv[])
   bool match_counting = false;
   uint8_t mode = 0;
   size_t num_fields = 1;
+  size_t exchange_cost_size = 0;
 #ifdef SEL_STATS
   string benchmark_filepath;
 #endif
@@ -557,6 +649,21 @@ int main(int argc, char *argv[])
     ("n,dbsize", "Database size", cxxopts::value(dbsize))
     ("N,nrecords", "Number of client records", cxxopts::value(nrecords))
     ("R,run-both", "Use set_both_inputs()", cxxopts::value(run_both))
+    ("b,batch", "Evaluate all records in a single SIMD circuit.",
+        cxxopts::value(batch_records))
+    ("C,chunk-size", "Link the database in consecutive circuits of this many "
+        "records. 0 (default): single circuit.", cxxopts::value(chunk_size))
+    ("X,max-exchanged-fields", "Only consider permutations of exchange groups "
+        "that exchange at most this many fields. 0 (default): all permutations.",
+        cxxopts::value(max_exchanged_fields))
+    ("int-div-files", "Read integer division circuits from the precomputed "
+        "files instead of generating them.", cxxopts::value(use_int_div_files))
+    ("w,word-size", "Circuit word size: 16, 32 (default) or 64. "
+        "0: smallest that fits the fields.", cxxopts::value(word_size))
+    ("exchange-cost-report", "Print the circuit size of exchange groups up to "
+        "this size as CSV, with and without --max-exchanged-fields, for the "
+        "selected sharing and conversion.",
+        cxxopts::value(exchange_cost_size))
     ("L,local-only", "Only run local calculations on clear values."
         " Doesn't initialize the SecureEpilinker.", cxxopts::value(only_local))
     ("m,match-count", "Run match counting instead of linkage.", cxxopts::value(match_counting))
@@ -590,6 +697,14 @@ int main(int argc, char *argv[])
   }
   logger = get_logger(ComponentLogger::TEST);
 
+  role = role_client ? MPCRole::CLIENT : MPCRole::SERVER;
+  sharing = sharing_num ? BooleanSharing::YAO : BooleanSharing::GMW;
+
+  if (exchange_cost_size) {
+    print_exchange_group_costs(exchange_cost_size);
+    return 0;
+  }
+
   const auto in = generate_modal_epilink_input(dbsize, nrecords, num_fields, mode);
   //const auto in = input_multi_test_0824();
 
@@ -598,14 +713,11 @@ int main(int argc, char *argv[])
     return 0;
   }
 
-  role = role_client ? MPCRole::CLIENT : MPCRole::SERVER;
-  sharing = sharing_num ? BooleanSharing::YAO : BooleanSharing::GMW;
-
   SecureEpilinker::ABYConfig aby_cfg {
     role, server_host, 5676, nthreads
   };
 
-  const auto circ_cfg = make_circuit_config<CircUnit>(in.cfg);
+  const auto circ_cfg = make_circuit_config(in.cfg, word_size);
   SecureEpilinker linker{aby_cfg, circ_cfg};
   if(!only_local) linker.connect();
   /* in counting mode, we don't really know if the calculations are correct, as
@@ -625,6 +737,10 @@ int main(int argc, char *argv[])
     print_toml(bfile, "arithConversion", use_conversion);
     print_toml(bfile, "dbSize", dbsize);
     print_toml(bfile, "numRecords", nrecords);
+    print_toml(bfile, "chunkSize", chunk_size);
+    print_toml(bfile, "maxExchangedFields", max_exchanged_fields);
+    print_toml(bfile, "intDivFiles", use_int_div_files);
+    print_toml(bfile, "wordSize", circ_cfg.bitlen);
 
     auto stats = linker.get_stats_printer();
     stats.set_output(&bfile);
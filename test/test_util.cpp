@@ -1,5 +1,7 @@
 #include "fmt/format.h"
 #include "../include/util.h"
+#include "../include/math.h"
+#include <cassert>
 
 using namespace std;
 
@@ -52,7 +54,7 @@ void test_map_str_double_to_vector_double() {
 
 using namespace sel;
 
-int main(int argc, char *argv[])
+int main()
 {
   test_vector_bool_to_bitmask();
   test_ceil_log2();